@@ -12,6 +12,9 @@ lcMemFile::lcMemFile()
 	mBufferSize = 0;
 	mFileSize = 0;
 	mBuffer = nullptr;
+/*** LPub3D Mod - mapped archives ***/
+	mView = false;
+/*** LPub3D Mod end ***/
 }
 
 lcMemFile::~lcMemFile()
@@ -36,6 +39,10 @@ long lcMemFile::GetPosition() const
 
 void lcMemFile::SetLength(size_t NewLength)
 {
+/*** LPub3D Mod - mapped archives ***/
+	Detach();
+/*** LPub3D Mod end ***/
+
 	if (NewLength > mBufferSize)
 		GrowFile(NewLength);
 
@@ -58,10 +65,45 @@ void lcMemFile::Close()
 	mPosition = 0;
 	mBufferSize = 0;
 	mFileSize = 0;
-	free(mBuffer);
+/*** LPub3D Mod - mapped archives ***/
+	if (!mView)
+		free(mBuffer);
+	mView = false;
+/*** LPub3D Mod end ***/
 	mBuffer = nullptr;
 }
 
+/*** LPub3D Mod - mapped archives ***/
+// Makes the file a read-only view of memory it does not own, the first write copies it.
+void lcMemFile::SetView(const void* Data, size_t Length)
+{
+	Close();
+
+	mBuffer = (unsigned char*)Data;
+	mBufferSize = Length;
+	mFileSize = Length;
+	mView = true;
+}
+
+void lcMemFile::Detach()
+{
+	if (!mView)
+		return;
+
+	const unsigned char* Data = mBuffer;
+	const size_t Length = mFileSize;
+
+	mBuffer = nullptr;
+	mBufferSize = 0;
+	mView = false;
+
+	GrowFile(Length);
+
+	if (mBuffer)
+		memcpy(mBuffer, Data, Length);
+}
+/*** LPub3D Mod end ***/
+
 size_t lcMemFile::ReadBuffer(void* Buffer, size_t Bytes)
 {
 	if (Bytes == 0 || mPosition > mFileSize)
@@ -85,6 +127,10 @@ size_t lcMemFile::WriteBuffer(const void* Buffer, size_t Bytes)
 	if (Bytes == 0)
 		return 0;
 
+/*** LPub3D Mod - mapped archives ***/
+	Detach();
+/*** LPub3D Mod end ***/
+
 	if (mPosition + Bytes > mBufferSize)
 		GrowFile(mPosition + Bytes);
 
@@ -100,6 +146,10 @@ size_t lcMemFile::WriteBuffer(const void* Buffer, size_t Bytes)
 
 void lcMemFile::GrowFile(size_t NewLength)
 {
+/*** LPub3D Mod - mapped archives ***/
+	Detach();
+/*** LPub3D Mod end ***/
+
 	if (NewLength <= mBufferSize)
 		return;
 
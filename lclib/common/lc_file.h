@@ -33,6 +33,14 @@ public:
 	virtual size_t ReadBuffer(void* Buffer, size_t Bytes) = 0;
 	virtual size_t WriteBuffer(const void* Buffer, size_t Bytes) = 0;
 
+/*** LPub3D Mod - mapped archives ***/
+	// Returns the whole file in memory, valid until the file is closed, or nullptr.
+	virtual const unsigned char* Map()
+	{
+		return nullptr;
+	}
+/*** LPub3D Mod end ***/
+
 	quint8 ReadU8()
 	{
 		quint8 Value;
@@ -469,11 +477,24 @@ public:
 
 	void GrowFile(size_t NewLength);
 
+/*** LPub3D Mod - mapped archives ***/
+	const unsigned char* Map() override
+	{
+		return mBuffer;
+	}
+
+	void SetView(const void* Data, size_t Length);
+	void Detach();
+/*** LPub3D Mod end ***/
+
 	size_t mGrowBytes;
 	size_t mPosition;
 	size_t mBufferSize;
 	size_t mFileSize;
 	unsigned char* mBuffer;
+/*** LPub3D Mod - mapped archives ***/
+	bool mView;
+/*** LPub3D Mod end ***/
 };
 
 class lcDiskFile : public lcFile
@@ -549,6 +570,13 @@ public:
 		return mFile.open(Flags);
 	}
 
+/*** LPub3D Mod - mapped archives ***/
+	const unsigned char* Map() override
+	{
+		return mFile.map(0, mFile.size());
+	}
+/*** LPub3D Mod end ***/
+
 protected:
 	QFile mFile;
 };
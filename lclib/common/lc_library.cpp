@@ -22,6 +22,8 @@
 /*** LPub3D Mod - Includes ***/
 #include "lpub.h"
 #include "version.h"
+#include <QLockFile>
+#include <QSaveFile>
 /*** LPub3D Mod end ***/
 
 #if MAX_MEM_LEVEL >= 8
@@ -30,9 +32,21 @@
 #  define DEF_MEM_LEVEL  MAX_MEM_LEVEL
 #endif
 
+/*** LPub3D Mod - zero-copy mesh ***/
+/*
 #define LC_LIBRARY_CACHE_VERSION   0x0108
+*/
+#define LC_LIBRARY_CACHE_VERSION   0x0109 // resets packs holding 0x0118 mesh records
+/*** LPub3D Mod end ***/
 #define LC_LIBRARY_CACHE_ARCHIVE   0x0001
 #define LC_LIBRARY_CACHE_DIRECTORY 0x0002
+/*** LPub3D Mod - mesh cache pack ***/
+#define LC_LIBRARY_CACHE_PACK      0x0004
+#define LC_LIBRARY_CACHE_RETIRED   0x0008 // set on a pack replaced by a rewrite
+#define LC_CACHE_PACK_ALIGN        16
+#define LC_CACHE_PACK_LOCK_TIMEOUT 5000 // ms
+#define LC_CACHE_PACK_COMPACT_RATIO 4   // rewrite once a quarter of the pack is superseded
+/*** LPub3D Mod end ***/
 /*** LPub3D Mod - part types ***/
 #define LC_LIBRARY_PART_TYPE       1
 /*** LPub3D Mod end ***/
@@ -64,6 +78,12 @@ lcPiecesLibrary::lcPiecesLibrary()
 	mHasUnofficial = false;
 	mCancelLoading = false;
 	mStudLogo = lcGetProfileInt(LC_PROFILE_STUD_LOGO);
+/*** LPub3D Mod - mesh cache pack ***/
+	mCachePackData = nullptr;
+	mCachePackMappedSize = 0;
+	mCachePackEnd = 0;
+	mCachePackUnavailable = false;
+/*** LPub3D Mod end ***/
 }
 
 lcPiecesLibrary::~lcPiecesLibrary()
@@ -95,6 +115,9 @@ void lcPiecesLibrary::Unload()
 	mZipFiles[LC_ZIPFILE_OFFICIAL] = nullptr;
 	delete mZipFiles[LC_ZIPFILE_UNOFFICIAL];
 	mZipFiles[LC_ZIPFILE_UNOFFICIAL] = nullptr;
+/*** LPub3D Mod - mesh cache pack ***/
+	CloseCachePack();
+/*** LPub3D Mod end ***/
 }
 
 void lcPiecesLibrary::RemoveTemporaryPieces()
@@ -350,6 +373,11 @@ bool lcPiecesLibrary::OpenArchive(lcFile* File, const QString& FileName, lcZipFi
 		return false;
 	}
 
+/*** LPub3D Mod - mapped archives ***/
+	if (Preferences::mapPartsArchives && !ZipFile->Map())
+		gui->messageSig(LOG_INFO, QString("Could not map %1, reading it through the file instead.").arg(FileName));
+/*** LPub3D Mod end ***/
+
 	mZipFiles[ZipFileType] = ZipFile;
 
 	if (ZipFileType == LC_ZIPFILE_OFFICIAL)
@@ -1113,6 +1141,8 @@ bool lcPiecesLibrary::SaveArchiveCacheIndex(const QString& FileName)
 	return WriteArchiveCacheFile(FileName, IndexFile);
 }
 
+/*** LPub3D Mod - mesh cache pack ***/
+/*
 bool lcPiecesLibrary::LoadCachePiece(PieceInfo* Info)
 {
 	QString FileName = QFileInfo(QDir(mCachePath), QString::fromLatin1(Info->mFileName)).absoluteFilePath();
@@ -1156,6 +1186,393 @@ bool lcPiecesLibrary::SaveCachePiece(PieceInfo* Info)
 
 	return WriteArchiveCacheFile(FileName, MeshData);
 }
+*/
+
+// Piece meshes are cached in one append-only pack. Records are aligned so a
+// mesh can be read in place from the mapping of the pack, the index is built
+// by walking the records when the pack is opened.
+//
+// Other LPub3D instances share the pack and may have it mapped, so it is
+// only ever grown in place. Opening, repairing and appending happen under a
+// lock file. A pack that needs repair - other archives, a record cut short
+// by an interrupted write or too many superseded records - is rewritten to
+// a new file that replaces the old one. The old file is flagged retired so
+// instances still holding it reopen the pack before their next append, and
+// keep the mappings meshes were loaded from until the pack is closed.
+
+struct lcCachePackHeader
+{
+	quint32 Version;
+	quint32 Flags;
+	qint64 CheckSum[4];
+	quint32 Padding[2];
+};
+
+struct lcCachePackRecord
+{
+	quint32 RecordSize;       // record header, key and data with padding
+	quint32 KeySize;
+	quint32 DataSize;
+	quint32 UncompressedSize; // 0 when the data is stored uncompressed
+};
+
+static qint64 lcCachePackAlign(qint64 Size)
+{
+	return (Size + LC_CACHE_PACK_ALIGN - 1) & ~(qint64)(LC_CACHE_PACK_ALIGN - 1);
+}
+
+static QByteArray lcCachePackRecordData(const QByteArray& Key, const QByteArray& Data, quint32 UncompressedSize, qint64* DataStart)
+{
+	*DataStart = lcCachePackAlign(sizeof(lcCachePackRecord) + Key.size());
+
+	lcCachePackRecord Record;
+	Record.RecordSize = (quint32)lcCachePackAlign(*DataStart + Data.size());
+	Record.KeySize = Key.size();
+	Record.DataSize = Data.size();
+	Record.UncompressedSize = UncompressedSize;
+
+	QByteArray RecordData(Record.RecordSize, 0);
+	memcpy(RecordData.data(), &Record, sizeof(Record));
+	memcpy(RecordData.data() + sizeof(Record), Key.constData(), Key.size());
+	memcpy(RecordData.data() + *DataStart, Data.constData(), Data.size());
+
+	return RecordData;
+}
+
+static bool lcCachePackRetired(QFile& PackFile)
+{
+	quint32 Flags;
+
+	if (!PackFile.seek(offsetof(lcCachePackHeader, Flags)) || PackFile.read((char*)&Flags, sizeof(Flags)) != sizeof(Flags))
+		return true;
+
+	return (Flags & LC_LIBRARY_CACHE_RETIRED) != 0;
+}
+
+bool lcPiecesLibrary::OpenCachePack()
+{
+	if (mCachePackFile.isOpen())
+		return true;
+
+	if (mCachePackUnavailable)
+		return false;
+
+	mCachePackUnavailable = true;
+
+	const QString FileName = QFileInfo(QDir(mCachePath), QLatin1String("pieces.pack")).absoluteFilePath();
+	QLockFile PackLock(FileName + QLatin1String(".lock"));
+
+	if (!PackLock.tryLock(LC_CACHE_PACK_LOCK_TIMEOUT))
+		return false;
+
+	mCachePackFile.setFileName(FileName);
+
+	if (!mCachePackFile.open(QIODevice::ReadWrite))
+		return false;
+
+	lcCachePackHeader Header;
+	bool Rewrite = false;
+	qint64 LiveSize = sizeof(Header);
+	qint64 FileSize = mCachePackFile.size();
+	mCachePackEnd = sizeof(Header);
+
+	if (mCachePackFile.read((char*)&Header, sizeof(Header)) != sizeof(Header) || Header.Version != LC_LIBRARY_CACHE_VERSION ||
+		Header.Flags != LC_LIBRARY_CACHE_PACK || memcmp(Header.CheckSum, mArchiveCheckSum, sizeof(Header.CheckSum)))
+		Rewrite = true;
+	else
+	{
+		for (;;)
+		{
+			lcCachePackRecord Record;
+
+			if (mCachePackEnd + (qint64)sizeof(Record) > FileSize || !mCachePackFile.seek(mCachePackEnd) ||
+				mCachePackFile.read((char*)&Record, sizeof(Record)) != sizeof(Record))
+				break;
+
+			const qint64 DataOffset = mCachePackEnd + lcCachePackAlign(sizeof(Record) + Record.KeySize);
+
+			if (Record.RecordSize < sizeof(Record) || mCachePackEnd + Record.RecordSize > FileSize ||
+				DataOffset + Record.DataSize > mCachePackEnd + Record.RecordSize)
+				break;
+
+			const QByteArray Key = mCachePackFile.read(Record.KeySize);
+
+			if (Key.size() != (int)Record.KeySize)
+				break;
+
+			const auto EntryIt = mCachePackIndex.constFind(Key);
+
+			if (EntryIt != mCachePackIndex.constEnd())
+				LiveSize -= lcCachePackAlign(lcCachePackAlign(sizeof(Record) + Key.size()) + EntryIt.value().DataSize);
+
+			mCachePackIndex[Key] = { DataOffset, Record.DataSize, Record.UncompressedSize };
+			mCachePackEnd += Record.RecordSize;
+			LiveSize += Record.RecordSize;
+		}
+
+		// A torn tail can only be left by a crash as appends hold the lock
+		Rewrite = mCachePackEnd < FileSize || LiveSize < mCachePackEnd - mCachePackEnd / LC_CACHE_PACK_COMPACT_RATIO;
+	}
+
+	if (Rewrite && !RewriteCachePack())
+	{
+		mCachePackIndex.clear();
+		mCachePackFile.close();
+		return false;
+	}
+
+	// Records appended after this are read through the file until the pack is opened again.
+	// Meshes keep pointers into the mapping, so it is made through a read-only handle: a
+	// stray write faults instead of corrupting the pack other instances share.
+	FileSize = mCachePackEnd;
+	QFile* MapFile = new QFile(FileName);
+
+	if (FileSize > (qint64)sizeof(Header) && MapFile->open(QIODevice::ReadOnly))
+		mCachePackData = MapFile->map(0, FileSize);
+
+	if (mCachePackData)
+		mCachePackMapFiles.push_back(MapFile);
+	else
+		delete MapFile;
+
+	mCachePackMappedSize = mCachePackData ? FileSize : 0;
+	mCachePackUnavailable = false;
+
+	return true;
+}
+
+// Write the live records to a new pack and replace the open one with it. The
+// old file is never truncated as another instance may still have it mapped.
+bool lcPiecesLibrary::RewriteCachePack()
+{
+	lcCachePackHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	Header.Version = LC_LIBRARY_CACHE_VERSION;
+	Header.Flags = LC_LIBRARY_CACHE_PACK;
+	memcpy(Header.CheckSum, mArchiveCheckSum, sizeof(Header.CheckSum));
+
+	const QString FileName = mCachePackFile.fileName();
+	QSaveFile PackFile(FileName);
+
+	if (!PackFile.open(QIODevice::WriteOnly) || PackFile.write((const char*)&Header, sizeof(Header)) != sizeof(Header))
+		return false;
+
+	QHash<QByteArray, lcCachePackEntry> PackIndex;
+	qint64 PackEnd = sizeof(Header);
+
+	for (auto EntryIt = mCachePackIndex.constBegin(); EntryIt != mCachePackIndex.constEnd(); ++EntryIt)
+	{
+		const lcCachePackEntry& Entry = EntryIt.value();
+
+		if (!mCachePackFile.seek(Entry.Offset))
+			continue;
+
+		const QByteArray Data = mCachePackFile.read(Entry.DataSize);
+
+		if (Data.size() != (int)Entry.DataSize)
+			continue;
+
+		qint64 DataStart;
+		const QByteArray RecordData = lcCachePackRecordData(EntryIt.key(), Data, Entry.UncompressedSize, &DataStart);
+
+		if (PackFile.write(RecordData) != RecordData.size())
+			return false;
+
+		PackIndex[EntryIt.key()] = { PackEnd + DataStart, Entry.DataSize, Entry.UncompressedSize };
+		PackEnd += RecordData.size();
+	}
+
+	// Windows cannot replace an open file, so there a replaced pack was not held by
+	// any instance. Elsewhere the old file is flagged retired once it is replaced,
+	// as instances that still hold it must not append to it.
+#ifdef Q_OS_WIN
+	mCachePackFile.close();
+#endif
+
+	if (!PackFile.commit())
+	{
+		mCachePackFile.close();
+		return false;
+	}
+
+#ifndef Q_OS_WIN
+	const quint32 RetiredFlags = LC_LIBRARY_CACHE_PACK | LC_LIBRARY_CACHE_RETIRED;
+
+	if (mCachePackFile.size() >= (qint64)sizeof(Header) && mCachePackFile.seek(offsetof(lcCachePackHeader, Flags)))
+		mCachePackFile.write((const char*)&RetiredFlags, sizeof(RetiredFlags));
+
+	mCachePackFile.close();
+#endif
+
+	mCachePackFile.setFileName(FileName);
+
+	if (!mCachePackFile.open(QIODevice::ReadWrite))
+		return false;
+
+	mCachePackIndex = PackIndex;
+	mCachePackEnd = PackEnd;
+
+	return true;
+}
+
+// Close a pack another instance replaced so the next access opens the new
+// file. The mappings of the retired file stay until the pack is closed, as
+// meshes loaded from them still point into them.
+void lcPiecesLibrary::RetireCachePack()
+{
+	mCachePackData = nullptr;
+	mCachePackMappedSize = 0;
+	mCachePackEnd = 0;
+	mCachePackIndex.clear();
+	mCachePackFile.close();
+}
+
+void lcPiecesLibrary::CloseCachePack()
+{
+	QMutexLocker Lock(&mCachePackMutex);
+
+	RetireCachePack();
+
+	// Closing a handle unmaps its mapping
+	for (QFile* MapFile : mCachePackMapFiles)
+		delete MapFile;
+	mCachePackMapFiles.clear();
+
+	mCachePackUnavailable = false;
+}
+
+bool lcPiecesLibrary::LoadCachePiece(PieceInfo* Info)
+{
+	const QByteArray Key = QByteArray(Info->mFileName) + ':' + QByteArray::number(mStudLogo);
+	lcCachePackEntry Entry;
+	QByteArray Buffer;
+	const uchar* Data;
+
+	{
+		QMutexLocker Lock(&mCachePackMutex);
+
+		if (!OpenCachePack())
+			return false;
+
+		const auto EntryIt = mCachePackIndex.constFind(Key);
+
+		if (EntryIt == mCachePackIndex.constEnd())
+			return false;
+
+		Entry = EntryIt.value();
+
+		if (Entry.Offset + Entry.DataSize <= mCachePackMappedSize)
+			Data = mCachePackData + Entry.Offset;
+		else
+		{
+			if (!mCachePackFile.seek(Entry.Offset))
+				return false;
+
+			Buffer = mCachePackFile.read(Entry.DataSize);
+
+			if (Buffer.size() != (int)Entry.DataSize)
+				return false;
+
+			Data = (const uchar*)Buffer.constData();
+		}
+	}
+
+	lcMemFile MeshData;
+
+	if (!Entry.UncompressedSize)
+		MeshData.SetView(Data, Entry.DataSize);
+	else
+	{
+		uLongf Length = Entry.UncompressedSize;
+
+		MeshData.SetLength(Entry.UncompressedSize);
+
+		if (uncompress(MeshData.mBuffer, &Length, Data, Entry.DataSize) != Z_OK || Length != Entry.UncompressedSize)
+			return false;
+	}
+
+	MeshData.Seek(0, SEEK_SET);
+
+	// Meshes loaded from the mapping keep pointing into it. The mapping is read-only,
+	// the mapped file is never shrunk, other instances replace it instead, and
+	// Unload() deletes the pieces before closing the pack.
+	const bool MapData = !Entry.UncompressedSize && Buffer.isNull();
+
+	lcMesh* Mesh = new lcMesh;
+	if (Mesh->FileLoad(MeshData, MapData))
+	{
+		Info->SetMesh(Mesh);
+		return true;
+	}
+	else
+	{
+		delete Mesh;
+		return false;
+	}
+}
+
+bool lcPiecesLibrary::SaveCachePiece(PieceInfo* Info)
+{
+	lcMemFile MeshData;
+
+	if (!Info->GetMesh()->FileSave(MeshData))
+		return false;
+
+	QByteArray Data = QByteArray::fromRawData((const char*)MeshData.mBuffer, (int)MeshData.GetLength());
+	quint32 UncompressedSize = 0;
+
+	if (Preferences::compressMeshCache)
+	{
+		uLongf Length = compressBound((uLong)MeshData.GetLength());
+		QByteArray CompressedData((int)Length, 0);
+
+		if (compress2((Bytef*)CompressedData.data(), &Length, MeshData.mBuffer, (uLong)MeshData.GetLength(), Z_DEFAULT_COMPRESSION) == Z_OK)
+		{
+			CompressedData.resize((int)Length);
+			Data = CompressedData;
+			UncompressedSize = (quint32)MeshData.GetLength();
+		}
+	}
+
+	const QByteArray Key = QByteArray(Info->mFileName) + ':' + QByteArray::number(mStudLogo);
+	qint64 DataStart;
+	const QByteArray RecordData = lcCachePackRecordData(Key, Data, UncompressedSize, &DataStart);
+
+	QMutexLocker Lock(&mCachePackMutex);
+
+	for (int Attempt = 0; Attempt < 2; Attempt++)
+	{
+		if (!OpenCachePack())
+			return false;
+
+		QLockFile PackLock(mCachePackFile.fileName() + QLatin1String(".lock"));
+
+		if (!PackLock.tryLock(LC_CACHE_PACK_LOCK_TIMEOUT))
+			return false;
+
+		// Another instance rewrote the pack, appends to the file held here would be lost
+		if (lcCachePackRetired(mCachePackFile))
+		{
+			PackLock.unlock();
+			RetireCachePack();
+			continue;
+		}
+
+		// Other instances may have appended since the pack was opened
+		const qint64 PackEnd = mCachePackFile.size();
+
+		if (!mCachePackFile.seek(PackEnd) || mCachePackFile.write(RecordData) != RecordData.size() || !mCachePackFile.flush())
+			return false;
+
+		mCachePackIndex[Key] = { PackEnd + DataStart, (quint32)Data.size(), UncompressedSize };
+		mCachePackEnd = PackEnd + RecordData.size();
+
+		return true;
+	}
+
+	return false;
+}
+/*** LPub3D Mod end ***/
 
 class lcSleeper : public QThread
 {
@@ -184,6 +184,12 @@ protected:
 	bool SaveArchiveCacheIndex(const QString& FileName);
 	bool LoadCachePiece(PieceInfo* Info);
 	bool SaveCachePiece(PieceInfo* Info);
+/*** LPub3D Mod - mesh cache pack ***/
+	bool OpenCachePack();
+	bool RewriteCachePack();
+	void RetireCachePack();
+	void CloseCachePack();
+/*** LPub3D Mod end ***/
 	bool ReadDirectoryCacheFile(const QString& FileName, lcMemFile& CacheFile);
 	bool WriteDirectoryCacheFile(const QString& FileName, lcMemFile& CacheFile);
 
@@ -200,6 +206,23 @@ protected:
 
 	QString mCachePath;
 	qint64 mArchiveCheckSum[4];
+/*** LPub3D Mod - mesh cache pack ***/
+	struct lcCachePackEntry
+	{
+		qint64 Offset;
+		quint32 DataSize;
+		quint32 UncompressedSize;
+	};
+
+	QMutex mCachePackMutex;
+	QFile mCachePackFile;
+	std::vector<QFile*> mCachePackMapFiles;
+	const uchar* mCachePackData;
+	qint64 mCachePackMappedSize;
+	qint64 mCachePackEnd;
+	bool mCachePackUnavailable;
+	QHash<QByteArray, lcCachePackEntry> mCachePackIndex;
+/*** LPub3D Mod end ***/
 	QString mLibraryFileName;
 	QString mUnofficialFileName;
 	lcZipFile* mZipFiles[LC_NUM_ZIPFILES];
@@ -8,7 +8,14 @@
 #include "lc_library.h"
 
 #define LC_MESH_FILE_ID      LC_FOURCC('M', 'E', 'S', 'H')
+/*** LPub3D Mod - zero-copy mesh ***/
+/*
 #define LC_MESH_FILE_VERSION 0x0118
+*/
+// 0x0119: vertex and index arrays start on LC_MESH_FILE_ALIGN boundaries
+#define LC_MESH_FILE_VERSION 0x0119
+#define LC_MESH_FILE_ALIGN   16
+/*** LPub3D Mod end ***/
 
 lcMesh* gPlaceholderMesh;
 
@@ -30,17 +37,27 @@ lcMesh::lcMesh()
 	mVertexCacheOffset = -1;
 	mIndexCacheOffset = -1;
 	mFlags = 0;
+/*** LPub3D Mod - zero-copy mesh ***/
+	mMappedData = false;
+/*** LPub3D Mod end ***/
 }
 
 lcMesh::~lcMesh()
 {
-	free(mVertexData);
-	free(mIndexData);
+/*** LPub3D Mod - zero-copy mesh ***/
+	if (!mMappedData)
+	{
+		free(mVertexData);
+		free(mIndexData);
+	}
+/*** LPub3D Mod end ***/
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 		delete[] mLods[LodIdx].Sections;
 }
 
-void lcMesh::Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int NumTexturedVertices, int NumIndices)
+/*** LPub3D Mod - zero-copy mesh ***/
+void lcMesh::Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int NumTexturedVertices, int NumIndices, bool AllocateData)
+/*** LPub3D Mod end ***/
 {
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 	{
@@ -52,7 +69,9 @@ void lcMesh::Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int
 	mNumVertices = NumVertices;
 	mNumTexturedVertices = NumTexturedVertices;
 	mVertexDataSize = NumVertices * sizeof(lcVertex) + NumTexturedVertices * sizeof(lcVertexTextured);
-	mVertexData = malloc(mVertexDataSize);
+/*** LPub3D Mod - zero-copy mesh ***/
+	mVertexData = AllocateData ? malloc(mVertexDataSize) : nullptr;
+/*** LPub3D Mod end ***/
 
 	if (NumVertices < 0x10000 && NumTexturedVertices < 0x10000)
 	{
@@ -65,7 +84,10 @@ void lcMesh::Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int
 		mIndexDataSize = NumIndices * sizeof(GLuint);
 	}
 
-	mIndexData = malloc(mIndexDataSize);
+/*** LPub3D Mod - zero-copy mesh ***/
+	mIndexData = AllocateData ? malloc(mIndexDataSize) : nullptr;
+	mMappedData = !AllocateData;
+/*** LPub3D Mod end ***/
 }
 
 void lcMesh::CreateBox()
@@ -369,7 +391,31 @@ void lcMesh::ExportWavefrontIndices(lcFile& File, int DefaultColorIndex, int Ver
 		ExportWavefrontIndices<GLuint>(File, DefaultColorIndex, VertexOffset);
 }
 
-bool lcMesh::FileLoad(lcMemFile& File)
+/*** LPub3D Mod - zero-copy mesh ***/
+static bool lcAlignMeshFile(lcMemFile& File)
+{
+	const size_t Position = File.GetPosition();
+	const size_t Padding = (LC_MESH_FILE_ALIGN - Position % LC_MESH_FILE_ALIGN) % LC_MESH_FILE_ALIGN;
+
+	if (Position + Padding > File.GetLength())
+		return false;
+
+	File.Seek(Padding, SEEK_CUR);
+	return true;
+}
+
+static void lcPadMeshFile(lcMemFile& File)
+{
+	static const char Padding[LC_MESH_FILE_ALIGN] = {};
+	const size_t Position = File.GetPosition();
+
+	File.WriteBuffer(Padding, (LC_MESH_FILE_ALIGN - Position % LC_MESH_FILE_ALIGN) % LC_MESH_FILE_ALIGN);
+}
+
+// With MapData set and File a view, the vertex and index arrays point into the view,
+// which the caller must keep alive for the lifetime of the mesh.
+bool lcMesh::FileLoad(lcMemFile& File, bool MapData)
+/*** LPub3D Mod end ***/
 {
 	if (File.ReadU32() != LC_MESH_FILE_ID || File.ReadU32() != LC_MESH_FILE_VERSION)
 		return false;
@@ -388,7 +434,14 @@ bool lcMesh::FileLoad(lcMemFile& File)
 	if (!File.ReadU16(&NumLods, 1) || NumLods != LC_NUM_MESH_LODS || !File.ReadU16(NumSections, LC_NUM_MESH_LODS))
 		return false;
 
-	Create(NumSections, NumVertices, NumTexturedVertices, NumIndices);
+/*** LPub3D Mod - zero-copy mesh ***/
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+	MapData = false;
+#endif
+	MapData = MapData && File.mView;
+
+	Create(NumSections, NumVertices, NumTexturedVertices, NumIndices, !MapData);
+/*** LPub3D Mod end ***/
 
 	for (int LodIdx = 0; LodIdx < LC_NUM_MESH_LODS; LodIdx++)
 	{
@@ -430,11 +483,31 @@ bool lcMesh::FileLoad(lcMemFile& File)
 		}
 	}
 
-	File.ReadBuffer(mVertexData, mNumVertices * sizeof(lcVertex) + mNumTexturedVertices * sizeof(lcVertexTextured));
-	if (mIndexType == GL_UNSIGNED_SHORT)
+/*** LPub3D Mod - zero-copy mesh ***/
+	if (!lcAlignMeshFile(File) || File.GetPosition() + (size_t)mVertexDataSize > File.GetLength())
+		return false;
+
+	if (MapData)
+	{
+		mVertexData = File.mBuffer + File.GetPosition();
+		File.Seek(mVertexDataSize, SEEK_CUR);
+	}
+	else
+		File.ReadBuffer(mVertexData, mVertexDataSize);
+
+	if (!lcAlignMeshFile(File) || File.GetPosition() + (size_t)mIndexDataSize > File.GetLength())
+		return false;
+
+	if (MapData)
+	{
+		mIndexData = File.mBuffer + File.GetPosition();
+		File.Seek(mIndexDataSize, SEEK_CUR);
+	}
+	else if (mIndexType == GL_UNSIGNED_SHORT)
 		File.ReadU16((quint16*)mIndexData, mIndexDataSize / 2);
 	else
 		File.ReadU32((quint32*)mIndexData, mIndexDataSize / 4);
+/*** LPub3D Mod end ***/
 
 	return true;
 }
@@ -482,7 +555,11 @@ bool lcMesh::FileSave(lcMemFile& File)
 		}
 	}
 
+/*** LPub3D Mod - zero-copy mesh ***/
+	lcPadMeshFile(File);
 	File.WriteBuffer(mVertexData, mNumVertices * sizeof(lcVertex) + mNumTexturedVertices * sizeof(lcVertexTextured));
+	lcPadMeshFile(File);
+/*** LPub3D Mod end ***/
 	if (mIndexType == GL_UNSIGNED_SHORT)
 		File.WriteU16((quint16*)mIndexData, mIndexDataSize / 2);
 	else
@@ -71,10 +71,20 @@ public:
 	lcMesh();
 	~lcMesh();
 
+/*** LPub3D Mod - zero-copy mesh ***/
+/*
 	void Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int NumTexturedVertices, int NumIndices);
+*/
+	void Create(quint16 NumSections[LC_NUM_MESH_LODS], int NumVertices, int NumTexturedVertices, int NumIndices, bool AllocateData = true);
+/*** LPub3D Mod end ***/
 	void CreateBox();
 
+/*** LPub3D Mod - zero-copy mesh ***/
+/*
 	bool FileLoad(lcMemFile& File);
+*/
+	bool FileLoad(lcMemFile& File, bool MapData = false);
+/*** LPub3D Mod end ***/
 	bool FileSave(lcMemFile& File);
 
 	template<typename IndexType>
@@ -110,6 +120,9 @@ public:
 	int mNumVertices;
 	int mNumTexturedVertices;
 	int mIndexType;
+/*** LPub3D Mod - zero-copy mesh ***/
+	bool mMappedData;
+/*** LPub3D Mod end ***/
 };
 
 extern lcMesh* gPlaceholderMesh;
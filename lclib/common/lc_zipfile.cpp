@@ -15,6 +15,10 @@ lcZipFile::lcZipFile()
 {
 	mModified = false;
 	mFile = nullptr;
+/*** LPub3D Mod - mapped archives ***/
+	mMappedData = nullptr;
+	mMappedSize = 0;
+/*** LPub3D Mod end ***/
 }
 
 lcZipFile::~lcZipFile()
@@ -50,6 +54,24 @@ bool lcZipFile::OpenRead(lcFile* File)
 	return true;
 }
 
+/*** LPub3D Mod - mapped archives ***/
+// Map the open archive so entries are read from memory without the lock,
+// returns false and keeps reading through the file if it cannot be mapped.
+bool lcZipFile::Map()
+{
+	if (!mFile)
+		return false;
+
+	if (!mMappedData)
+	{
+		mMappedData = mFile->Map();
+		mMappedSize = mMappedData ? mFile->GetLength() : 0;
+	}
+
+	return mMappedData != nullptr;
+}
+/*** LPub3D Mod end ***/
+
 bool lcZipFile::OpenWrite(const QString& FileName)
 {
 	lcDiskFile* File = new lcDiskFile(FileName);
@@ -197,6 +219,33 @@ quint64 lcZipFile::SearchCentralDir64()
 	return RelativeOffset;
 }
 
+/*** LPub3D Mod - concurrent extract ***/
+// Seek and read as one step, the only part of an extraction that uses mFile.
+size_t lcZipFile::ReadBufferAt(quint64 Offset, void* Buffer, size_t Bytes)
+{
+/*** LPub3D Mod - mapped archives ***/
+	if (mMappedData)
+	{
+		Offset += mBytesBeforeZipFile;
+
+		if (Offset >= mMappedSize)
+			return 0;
+
+		Bytes = (size_t)lcMin((quint64)Bytes, mMappedSize - Offset);
+		memcpy(Buffer, mMappedData + Offset, Bytes);
+
+		return Bytes;
+	}
+/*** LPub3D Mod end ***/
+
+	QMutexLocker Lock(&mMutex);
+
+	mFile->Seek(Offset + mBytesBeforeZipFile, SEEK_SET);
+
+	return mFile->ReadBuffer(Buffer, Bytes);
+}
+/*** LPub3D Mod end ***/
+
 bool lcZipFile::CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField)
 {
 	quint16 Number16, Flags;
@@ -208,41 +257,52 @@ bool lcZipFile::CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint6
 	*OffsetLocalExtraField = 0;
 	*SizeLocalExtraField = 0;
 
+/*** LPub3D Mod - mapped archives ***/
+/*
 	mFile->Seek(FileInfo.offset_curfile + mBytesBeforeZipFile, SEEK_SET);
+*/
+	// Read the local header in one go, a mapped archive needs no lock for it
+	quint8 HeaderData[0x1e];
+	if (ReadBufferAt(FileInfo.offset_curfile, HeaderData, sizeof(HeaderData)) != sizeof(HeaderData))
+		return false;
 
-	if (mFile->ReadU32(&Magic, 1) != 1 || Magic != 0x04034b50)
+	lcMemFile Header;
+	Header.SetView(HeaderData, sizeof(HeaderData));
+/*** LPub3D Mod end ***/
+
+	if (Header.ReadU32(&Magic, 1) != 1 || Magic != 0x04034b50)
 		return false;
 
-	if (mFile->ReadU16(&Number16, 1) != 1)
+	if (Header.ReadU16(&Number16, 1) != 1)
 		return false;
 
-	if (mFile->ReadU16(&Flags, 1) != 1)
+	if (Header.ReadU16(&Flags, 1) != 1)
 		return false;
 
-	if (mFile->ReadU16(&Number16, 1) != 1 || Number16 != FileInfo.compression_method)
+	if (Header.ReadU16(&Number16, 1) != 1 || Number16 != FileInfo.compression_method)
 		return false;
 
 	if (FileInfo.compression_method != 0 && FileInfo.compression_method != Z_DEFLATED)
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1)
+	if (Header.ReadU32(&Number32, 1) != 1)
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || ((Number32 != FileInfo.crc) && ((Flags & 8)==0)))
+	if (Header.ReadU32(&Number32, 1) != 1 || ((Number32 != FileInfo.crc) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.compressed_size) && ((Flags & 8)==0)))
+	if (Header.ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.compressed_size) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.uncompressed_size) && ((Flags & 8)==0)))
+	if (Header.ReadU32(&Number32, 1) != 1 || (Number32 != 0xffffffffU && (Number32 != FileInfo.uncompressed_size) && ((Flags & 8)==0)))
 		return false;
 
-	if (mFile->ReadU16(&SizeFilename, 1) != 1 || SizeFilename != FileInfo.size_filename)
+	if (Header.ReadU16(&SizeFilename, 1) != 1 || SizeFilename != FileInfo.size_filename)
 		return false;
 
 	*SizeVar += SizeFilename;
 
-	if (mFile->ReadU16(&SizeExtraField, 1) != 1)
+	if (Header.ReadU16(&SizeExtraField, 1) != 1)
 		return false;
 
 	*OffsetLocalExtraField= FileInfo.offset_curfile + 0x1e + SizeFilename;
@@ -363,6 +423,10 @@ bool lcZipFile::ReadCentralDir()
 
 	mFile->Seek(PosInCentralDir + mBytesBeforeZipFile, SEEK_SET);
 	mFiles.AllocGrow((int)mNumEntries);
+/*** LPub3D Mod - zip file index ***/
+	mFileIndex.clear();
+	mFileIndex.reserve((int)mNumEntries);
+/*** LPub3D Mod end ***/
 
 	for (quint64 FileNum = 0; FileNum < mNumEntries; FileNum++)
 	{
@@ -452,6 +516,13 @@ bool lcZipFile::ReadCentralDir()
 			if (mFile->ReadBuffer(FileInfo.file_name, SizeRead) != SizeRead)
 				return false;
 		Seek -= SizeRead;
+
+/*** LPub3D Mod - zip file index ***/
+		// Case folded like qstricmp, the first of duplicate names is kept
+		const QByteArray Key = QByteArray(FileInfo.file_name).toLower();
+		if (!mFileIndex.contains(Key))
+			mFileIndex.insert(Key, (int)FileNum);
+/*** LPub3D Mod end ***/
 /*
 		// Read extrafield
 		if ((err==UNZ_OK) && (extraField!=nullptr))
@@ -577,8 +648,17 @@ bool lcZipFile::ReadCentralDir()
 	return true;
 }
 
+/*** LPub3D Mod - zip file index ***/
+int lcZipFile::FindFile(const char* FileName) const
+{
+	return mFileIndex.value(QByteArray(FileName).toLower(), -1);
+}
+/*** LPub3D Mod end ***/
+
 bool lcZipFile::ExtractFile(const char* FileName, lcMemFile& File, quint32 MaxLength)
 {
+/*** LPub3D Mod - zip file index ***/
+/*
 	for (int FileIdx = 0; FileIdx < mFiles.GetSize(); FileIdx++)
 	{
 		lcZipFileInfo& FileInfo = mFiles[FileIdx];
@@ -588,11 +668,20 @@ bool lcZipFile::ExtractFile(const char* FileName, lcMemFile& File, quint32 MaxLe
 	}
 
 	return false;
+*/
+	const int FileIdx = FindFile(FileName);
+
+	return FileIdx != -1 && ExtractFile(FileIdx, File, MaxLength);
+/*** LPub3D Mod end ***/
 }
 
 bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 {
+/*** LPub3D Mod - concurrent extract ***/
+/*
 	QMutexLocker Lock(&mMutex);
+*/
+/*** LPub3D Mod end ***/
 
 	quint32 SizeVar;
 	quint64 OffsetLocalExtraField;
@@ -633,6 +722,36 @@ bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 	Stream.avail_in = (uInt)0;
 
 	quint32 Length = lcMin((quint32)FileInfo.uncompressed_size, MaxLength);
+
+/*** LPub3D Mod - mapped archives ***/
+	const unsigned char* MappedData = nullptr;
+
+	if (mMappedData)
+	{
+		const quint64 Offset = PosInZipfile + mBytesBeforeZipFile;
+
+		if (Offset > mMappedSize || FileInfo.compressed_size > mMappedSize - Offset || FileInfo.compressed_size > 0xffffffffU)
+		{
+			if (FileInfo.compression_method == Z_DEFLATED)
+				inflateEnd(&Stream);
+			return false;
+		}
+
+		MappedData = mMappedData + Offset;
+
+		// Stored entries are handed out as a view of the mapping
+		if (FileInfo.compression_method == 0)
+		{
+			if (FileInfo.compressed_size < Length)
+				return false;
+
+			File.SetView(MappedData, Length);
+
+			return true;
+		}
+	}
+/*** LPub3D Mod end ***/
+
 	File.SetLength(Length);
 	File.Seek(0, SEEK_SET);
 
@@ -640,6 +759,16 @@ bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 	Stream.next_out = (Bytef*)File.mBuffer;
 	Stream.avail_out = Length;
 
+/*** LPub3D Mod - mapped archives ***/
+	// Inflate straight from the mapping
+	if (MappedData)
+	{
+		Stream.next_in = (Bytef*)MappedData;
+		Stream.avail_in = (uInt)RestReadCompressed;
+		RestReadCompressed = 0;
+	}
+/*** LPub3D Mod end ***/
+
 	quint32 Read = 0;
 
 	while (Stream.avail_out > 0)
@@ -654,9 +783,19 @@ bool lcZipFile::ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength)
 			if (ReadThis == 0)
 				return false;
 
+/*** LPub3D Mod - concurrent extract ***/
+/*
 			mFile->Seek(PosInZipfile + mBytesBeforeZipFile, SEEK_SET);
 			if (mFile->ReadBuffer(ReadBuffer, ReadThis) != ReadThis)
 				return false;
+*/
+			if (ReadBufferAt(PosInZipfile, ReadBuffer, ReadThis) != ReadThis)
+			{
+				if (FileInfo.compression_method == Z_DEFLATED)
+					inflateEnd(&Stream);
+				return false;
+			}
+/*** LPub3D Mod end ***/
 
 			PosInZipfile += ReadThis;
 
@@ -63,9 +63,15 @@ public:
 	bool OpenRead(const QString& FileName);
 	bool OpenRead(lcFile* File);
 	bool OpenWrite(const QString& FileName);
+/*** LPub3D Mod - mapped archives ***/
+	bool Map();
+/*** LPub3D Mod end ***/
 
 	bool ExtractFile(int FileIndex, lcMemFile& File, quint32 MaxLength = 0xffffffff);
 	bool ExtractFile(const char* FileName, lcMemFile& File, quint32 MaxLength = 0xffffffff);
+/*** LPub3D Mod - zip file index ***/
+	int FindFile(const char* FileName) const;
+/*** LPub3D Mod end ***/
 
 	lcArray<lcZipFileInfo> mFiles;
 
@@ -75,9 +81,19 @@ protected:
 	quint64 SearchCentralDir();
 	quint64 SearchCentralDir64();
 	bool CheckFileCoherencyHeader(int FileIndex, quint32* SizeVar, quint64* OffsetLocalExtraField, quint32* SizeLocalExtraField);
+/*** LPub3D Mod - concurrent extract ***/
+	size_t ReadBufferAt(quint64 Offset, void* Buffer, size_t Bytes);
+/*** LPub3D Mod end ***/
 
 	QMutex mMutex;
 	lcFile* mFile;
+/*** LPub3D Mod - zip file index ***/
+	QHash<QByteArray, int> mFileIndex;
+/*** LPub3D Mod end ***/
+/*** LPub3D Mod - mapped archives ***/
+	const unsigned char* mMappedData;
+	quint64 mMappedSize;
+/*** LPub3D Mod end ***/
 
 	bool mModified;
 	bool mZip64;
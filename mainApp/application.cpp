@@ -448,6 +448,7 @@ void Application::initialize()
                 fprintf(stdout, "  +lv, ++libvexiq: Load the LDraw VEXIQ archive parts library in GUI mode.\n");
                 fprintf(stdout, "  -sl --stud-logo <type>: Set the stud logo type 0 - 5, default is 0 no logo.\n");
                 fprintf(stdout, "  -d, --image-output-directory <directory>: Designate the png, jpg or bmp save folder using absolute path.\n");
+                fprintf(stdout, "  -et, --export-threads <count>: Set the number of threads used to rasterize exported pdf page images and png, jpg or bmp pages. Page layout stays serial. Pdf pages exported as elements are not threaded. Threads are only used on platforms that support pixmaps outside the GUI thread. 0 uses all available cores. Default is 1, serial export.\n");
                 fprintf(stdout, "  -fc, --fade-steps-color <LDraw color code>: Set the global fade color. Overridden by fade opacity - if opacity not 100 percent. Default is %s\n",LEGO_FADE_COLOUR_DEFAULT);
                 fprintf(stdout, "  -fo, --fade-step-opacity <percent>: Set the fade steps opacity percent. Overrides fade color - if opacity not 100 percent. Default is %s percent\n",QString(FADE_OPACITY_DEFAULT).toLatin1().constData());
                 fprintf(stdout, "  -fs, --fade-steps: Turn on fade previous steps. Default is off.\n");
@@ -462,6 +463,7 @@ void Application::initialize()
                 fprintf(stdout, "  -p, --preferred-renderer <renderer>: Set renderer native, ldglite, ldview, ldview-sc, ldview-scsl, povray, or povray-ldv. Default is native.\n ");
                 fprintf(stdout, "  -pe, --process-export: Export instruction document or images. Used with export-option. Default is pdf document.\n");
                 fprintf(stdout, "  -pf, --process-file: Process ldraw file and generate images in png format.\n");
+                fprintf(stdout, "  -pl, --pdf-look-ahead <count>: Set the number of pdf page images rendered ahead of the pdf writer when using export threads. Default is %d.\n",PDF_PAGE_LOOK_AHEAD_DEFAULT);
                 fprintf(stdout, "  -pr, --projection <p,projection|o,orthographic>: Set camera projection.\n");
                 fprintf(stdout, "  -r, --range <page range>: Set page range - e.g. 1,2,9,10-42. Default is all pages.\n");
                 fprintf(stdout, "  -rs, --reset-search-dirs: Reset the LDraw parts directories to those searched by default. Default is off.\n");
@@ -32,6 +32,8 @@ int Gui::processCommandLine()
    int fadeStepsOpacity      = FADE_OPACITY_DEFAULT;
    int highlightLineWidth    = HIGHLIGHT_LINE_WIDTH_DEFAULT;
    int StudLogo              = lcGetProfileInt(LC_PROFILE_STUD_LOGO);
+   int exportThreads         = Preferences::exportThreads;
+   int pdfPageLookAhead      = Preferences::pdfPageLookAhead;
   bool processExport         = false;
   bool processFile           = false;
   bool perspectiveProjection = false;
@@ -178,6 +180,12 @@ int Gui::processCommandLine()
       else
       if (Param == QLatin1String("--line-width"))
         ParseInteger(highlightLineWidth);
+      else
+      if (Param == QLatin1String("-et") || Param == QLatin1String("--export-threads"))
+        ParseInteger(exportThreads);
+      else
+      if (Param == QLatin1String("-pl") || Param == QLatin1String("--pdf-look-ahead"))
+        ParseInteger(pdfPageLookAhead);
       else
         emit messageSig(LOG_INFO,QString("Unknown command line parameter: '%1'.").arg(Param));
     }
@@ -379,6 +387,22 @@ int Gui::processCommandLine()
       Preferences::highlightStepLineWidth = highlightLineWidth;
     }
 
+  if (exportThreads != Preferences::exportThreads) {
+      message = QString("Export threads changed from %1 to %2.")
+          .arg(Preferences::exportThreads)
+          .arg(exportThreads);
+      emit messageSig(LOG_INFO,message);
+      Preferences::exportThreads = exportThreads;
+    }
+
+  if (pdfPageLookAhead != Preferences::pdfPageLookAhead) {
+      message = QString("Pdf page look-ahead changed from %1 to %2.")
+          .arg(Preferences::pdfPageLookAhead)
+          .arg(pdfPageLookAhead);
+      emit messageSig(LOG_INFO,message);
+      Preferences::pdfPageLookAhead = pdfPageLookAhead;
+    }
+
   if (resetSearchDirs) {
       message = QString("Reset search directories requested..");
       emit messageSig(LOG_INFO,message);
@@ -39,7 +39,15 @@
 #include <QFile>
 #include <QRegExp>
 #include <QHash>
+#include <QMutex>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QtConcurrent>
 #include <functional>
+#include <algorithm>
+#include <cstring>
+#include <climits>
 
 #include "paths.h"
 
@@ -51,64 +59,218 @@
 #include "pieceinf.h"
 
 /********************************************
- *
- * routines for nested levels
  *
  ********************************************/
 
-QList<HiarchLevel*> LDrawFile::_currentLevels;
-QList<HiarchLevel*> LDrawFile::_allLevels;
-
-HiarchLevel* addLevel(const QString& key, bool create)
-{
-    for (HiarchLevel* level : LDrawFile::_allLevels)
-        if (level->key == key)
-            return level;
+QStringList LDrawFile::_loadedParts;
+QString LDrawFile::_file           = "";
+QString LDrawFile::_name           = "";
+QString LDrawFile::_author         = "";
+QString LDrawFile::_description    = "";
+QString LDrawFile::_category       = "";
+int     LDrawFile::_emptyInt;
+int     LDrawFile::_partCount      = 0;
+bool    LDrawFile::_currFileIsUTF8 = false;
+bool    LDrawFile::_showLoadMessages = false;
+bool    LDrawFile::_loadAborted    = false;
+QStringList LDrawFile::_partNames;
+QHash<QString, int> LDrawFile::_partIds;
+QMutex LDrawFile::_partIdsMutex;
+QHash<QString, QString> LDrawFile::_subFileIndex;
+QStringList LDrawFile::_subFileIndexDirs;
+bool    LDrawFile::_subFileIndexed = false;
+QMutex LDrawFile::_subFileIndexMutex;
+
+/*
+ * Tokenize a line once so the submodel scans can use its line type, colour,
+ * transform, part and meta command without splitting the text again.
+ */
+LDrawLine::LDrawLine(const QString &line)
+{
+  _type = -1;
+  _op = OtherOp;
+  _colour = 0;
+  _partId = -1;
+  _mirrored = false;
+  _metaCompiled = false;
+
+  QStringList tokens;
+  split(line,tokens);
+
+  if (tokens.isEmpty())
+    return;
+
+  bool ok;
+  _type = tokens[0].toInt(&ok);
+  if (! ok) {
+    _type = -1;
+    return;
+  }
+
+  if (_type >= 1 && _type <= 5 && tokens.size() > 1) {
+    if (tokens[1].startsWith("0x",Qt::CaseInsensitive))
+      _colour = tokens[1].mid(2).toInt(&ok,16);
+    else
+      _colour = tokens[1].toInt(&ok);
+  }
 
-    if (create)
-    {
-        HiarchLevel* level = new HiarchLevel(key);
-        LDrawFile::_allLevels.append(level);
-        return level;
+  if (_type == 1) {
+    if (tokens.size() == 15) {
+      for (int i = 0; i < 12; i++)
+        _matrix[i] = tokens[i+2].toFloat();
+      _partId = LDrawFile::partId(tokens[14]);
+      _mirrored = LDrawFile::mirrored(tokens);
+    }
+  } else if (_type == 0) {
+    bool lpub = tokens.size() >= 3 && (tokens[1] == "LPUB" || tokens[1] == "!LPUB");
+    if (lpub && tokens.size() == 4 && tokens[2] == "CALLOUT" && tokens[3] == "BEGIN") {
+      _op = CalloutBeginOp;
+    } else if (lpub && tokens.size() == 4 && tokens[2] == "CALLOUT" && tokens[3] == "END") {
+      _op = CalloutEndOp;
+    } else if (lpub && tokens.size() >= 4 && tokens[2] == "BUILD_MOD") {
+      if (tokens[3] == "BEGIN") {
+        _op = BuildModBeginOp;
+        if (tokens.size() > 4)
+          _buildModKey = tokens[4];
+      } else if (tokens[3] == "APPLY" || tokens[3] == "REMOVE") {
+        _op = BuildModActionOp;
+      } else if (tokens[3] == "END_MOD") {
+        _op = BuildModEndModOp;
+      } else if (tokens[3] == "END") {
+        _op = BuildModEndOp;
+      } else {
+        _op = BuildModOtherOp;
+      }
+    } else if (lpub && tokens.size() == 5 && (tokens[2] == "PART" || tokens[2] == "PLI") &&
+               tokens[3] == "BEGIN" && tokens[4] == "IGN") {
+      _op = PartIgnoreBeginOp;
+    } else if (lpub && tokens.size() == 4 && (tokens[2] == "PART" || tokens[2] == "PLI") &&
+               tokens[3] == "END") {
+      _op = PartIgnoreEndOp;
+    } else if (lpub && tokens.size() == 3 && tokens[2] == "NOSTEP") {
+      _op = NoStepOp;
+    } else if (tokens.size() >= 2 && (tokens[1] == "STEP" || tokens[1] == "ROTSTEP")) {
+      _op = StepOp;
+    } else if (tokens.size() == 4 && tokens[1] == "BUFEXCHG") {
+      _op = BufExchgOp;
+    } else if (line.contains("SUB",Qt::CaseInsensitive)) {
+      QString substitute = line, partToken;
+      if (isSubstitute(substitute,partToken))
+        _op = SubstituteOp;
     }
+  }
+}
 
-    return nullptr;
+int LDrawFile::partId(const QString &name)
+{
+  QMutexLocker locker(&_partIdsMutex);
+  QString key = name.toLower();
+  QHash<QString, int>::const_iterator i = _partIds.constFind(key);
+  if (i != _partIds.constEnd())
+    return i.value();
+  _partNames << name;
+  _partIds.insert(key,_partNames.size() - 1);
+  return _partNames.size() - 1;
 }
 
-int getLevel(const QString& key, int rc)
+QString LDrawFile::partName(int partId)
 {
-    if (rc == HiarchLevel::BEGIN) {
-        HiarchLevel* level = addLevel(key, true);
+  if (partId >= 0 && partId < _partNames.size())
+    return _partNames[partId];
+  return QString();
+}
 
-        if (!LDrawFile::_currentLevels.isEmpty())
-            level->level = LDrawFile::_currentLevels[LDrawFile::_currentLevels.size() - 1];
-        else
-            level->level = nullptr;
-        LDrawFile::_currentLevels.append(level);
+/*
+ * The extended subfile search directories in search order - the LDraw
+ * search directories followed by the LDraw library MODELS, PARTS, P and
+ * unofficial PARTS and P folders.
+ */
+QStringList LDrawFile::subFileSearchDirs()
+{
+  QStringList searchPaths = Preferences::ldSearchDirs;
+  QString ldrawPath = QDir::toNativeSeparators(Preferences::ldrawLibPath);
+  QStringList libraryPaths = QStringList()
+      << ldrawPath + QDir::separator() + "MODELS"
+      << ldrawPath + QDir::separator() + "PARTS"
+      << ldrawPath + QDir::separator() + "P"
+      << ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "PARTS"
+      << ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "P";
+  for (const QString &libraryPath : libraryPaths)
+    if (!searchPaths.contains(libraryPath,Qt::CaseInsensitive))
+      searchPaths.append(libraryPath);
+  return searchPaths;
+}
+
+/*
+ * Resolve a subfile name against the search directories using a case
+ * insensitive file name index. The index lists each directory once and is
+ * rebuilt when the search directories change or when a watched directory
+ * reports a change. Names that carry a path are probed directly.
+ */
+QString LDrawFile::findSubFile(const QString &fileName)
+{
+  static QFileSystemWatcher *watcher = nullptr;
+
+  if (fileName.contains('/') || fileName.contains('\\')) {
+    for (const QString &subFilePath : subFileSearchDirs()) {
+      QFileInfo fileInfo(subFilePath + QDir::separator() + fileName);
+      if (fileInfo.isFile())
+        return fileInfo.absoluteFilePath();
+    }
+    return QString();
+  }
 
-    } else if (rc == HiarchLevel::END) {
-        if (!LDrawFile::_currentLevels.isEmpty())
-            LDrawFile::_currentLevels.removeAt(LDrawFile::_currentLevels.size() - 1);
+  QMutexLocker locker(&_subFileIndexMutex);
+
+  QStringList searchPaths = subFileSearchDirs();
+  if (_subFileIndexed && searchPaths != _subFileIndexDirs)
+    _subFileIndexed = false;
+
+  if (!_subFileIndexed) {
+    _subFileIndex.clear();
+    _subFileIndexDirs = searchPaths;
+    QStringList watchDirs;
+    for (const QString &subFilePath : searchPaths) {
+      QDir dir(subFilePath);
+      if (!dir.exists())
+        continue;
+      watchDirs << dir.absolutePath();
+      const QStringList entries = dir.entryList(QDir::Files);
+      for (const QString &entry : entries) {
+        QString key = entry.toLower();
+        if (!_subFileIndex.contains(key))
+          _subFileIndex.insert(key, dir.absoluteFilePath(entry));
+      }
+    }
+    _subFileIndexed = true;
+
+    // the watcher lives on the GUI thread - lookups from worker threads
+    // still use the index but only the search directory check invalidates it
+    if (QThread::currentThread() == QCoreApplication::instance()->thread()) {
+      if (!watcher) {
+        watcher = new QFileSystemWatcher(QCoreApplication::instance());
+        QObject::connect(watcher, &QFileSystemWatcher::directoryChanged,
+                         [] (const QString &) { LDrawFile::clearSubFileIndex(); });
+      }
+      if (!watcher->directories().isEmpty())
+        watcher->removePaths(watcher->directories());
+      if (!watchDirs.isEmpty())
+        watcher->addPaths(watchDirs);
     }
 
-    return LDrawFile::_currentLevels.size();
-}
+    emit gui->messageSig(LOG_DEBUG, QString("Indexed %1 subfiles in %2 search directories.")
+                         .arg(_subFileIndex.size()).arg(watchDirs.size()));
+  }
 
-/********************************************
- *
- ********************************************/
+  return _subFileIndex.value(fileName.toLower());
+}
 
-QStringList LDrawFile::_loadedParts;
-QString LDrawFile::_file           = "";
-QString LDrawFile::_name           = "";
-QString LDrawFile::_author         = "";
-QString LDrawFile::_description    = "";
-QString LDrawFile::_category       = "";
-int     LDrawFile::_emptyInt;
-int     LDrawFile::_partCount      = 0;
-bool    LDrawFile::_currFileIsUTF8 = false;
-bool    LDrawFile::_showLoadMessages = false;
-bool    LDrawFile::_loadAborted    = false;
+void LDrawFile::clearSubFileIndex()
+{
+  QMutexLocker locker(&_subFileIndexMutex);
+  _subFileIndexed = false;
+  _subFileIndex.clear();
+}
 
 LDrawSubFile::LDrawSubFile(
   const QStringList &contents,
@@ -118,6 +280,7 @@ LDrawSubFile::LDrawSubFile(
   const QString     &subFilePath)
 {
   _contents << contents;
+  _packed = false;
   _subFilePath = subFilePath;
   _datetime = datetime;
   _modified = false;
@@ -132,6 +295,101 @@ LDrawSubFile::LDrawSubFile(
   _prevStepPosition = 0;
   _startPageNumber = 0;
   _lineTypeIndexes.clear();
+  _beenCounted = false;
+  _subFileRefsChanged = true;
+  _buildModsChanged = true;
+}
+
+void LDrawSubFile::tokenize()
+{
+  _lines.clear();
+  _lines.reserve(_contents.size());
+  foreach (const QString &line, _contents) {
+    _lines.append(LDrawLine(line));
+  }
+  _buildModsChanged = true;
+}
+
+/*
+ * Index the BUILD_MOD blocks of the submodel. Each way of tracking the
+ * nesting closes a block on a different command, so the closing line,
+ * enclosing block and level are kept for each; the blocks of one kind
+ * nest like the stack they replace.
+ */
+
+void LDrawSubFile::indexBuildMods()
+{
+  QVector<int> open[BuildModBlock::NumClose];
+
+  _buildModBlocks.clear();
+  for (int i = 0; i < _lines.size(); i++) {
+    const LDrawLine &line = _lines[i];
+    if (line._op == LDrawLine::BuildModBeginOp) {
+      BuildModBlock block;
+      block._key       = line._buildModKey.toLower();
+      block._beginLine = i;
+      for (int c = 0; c < BuildModBlock::NumClose; c++) {
+        block._closeLine[c] = INT_MAX;
+        block._parent[c]    = open[c].isEmpty() ? -1 : open[c].last();
+        block._level[c]     = open[c].size() + 1;
+        open[c].append(_buildModBlocks.size());
+      }
+      _buildModBlocks.append(block);
+    } else {
+      int c = line._op == LDrawLine::BuildModActionOp ? BuildModBlock::ActionClose :
+              line._op == LDrawLine::BuildModEndModOp ? BuildModBlock::EndModClose :
+              line._op == LDrawLine::BuildModEndOp    ? BuildModBlock::EndClose    : -1;
+      if (c != -1 && ! open[c].isEmpty())
+        _buildModBlocks[open[c].takeLast()]._closeLine[c] = i;
+    }
+  }
+  _buildModsChanged = false;
+}
+
+/*
+ * Packed contents keep the lines as UTF-8 with an offset per line;
+ * single lines are decoded on read and the list is rebuilt on the
+ * first access that needs all of it.
+ */
+
+void LDrawSubFile::pack()
+{
+  if (_packed || _contents.isEmpty())
+    return;
+  _packedOffsets.reserve(_contents.size());
+  foreach (const QString &line, _contents) {
+    _packedOffsets.append(_packedContents.size());
+    _packedContents.append(line.toUtf8());
+    _packedContents.append('\n');
+  }
+  _packedContents.squeeze();
+  _contents.clear();
+  _packed = true;
+}
+
+void LDrawSubFile::unpack()
+{
+  if (! _packed)
+    return;
+  _contents.reserve(_packedOffsets.size());
+  for (int i = 0; i < _packedOffsets.size(); i++) {
+    _contents << packedLine(i);
+  }
+  _packedContents.clear();
+  _packedOffsets.clear();
+  _packed = false;
+}
+
+QString LDrawSubFile::packedLine(int lineNumber) const
+{
+  int start = _packedOffsets[lineNumber];
+  int end   = lineNumber + 1 < _packedOffsets.size() ? _packedOffsets[lineNumber + 1] : _packedContents.size();
+  return QString::fromUtf8(_packedContents.constData() + start, end - start - 1);
+}
+
+static void tokenizeSubFile(LDrawSubFile *&subFile)
+{
+  subFile->tokenize();
 }
 
 /* initialize new Build Mod */
@@ -144,14 +402,10 @@ BuildMod::BuildMod(const QVector<int> &modAttributes,
 }
 
 /* initialize viewer step*/
-ViewerStep::ViewerStep(const QStringList &rotatedContents,
-                       const QStringList &unrotatedContents,
-                       const QString     &filePath,
+ViewerStep::ViewerStep(const QString     &filePath,
                        const QString     &csiKey,
                        bool               multiStep,
                        bool               calledOut){
-    _rotatedContents << rotatedContents;
-    _unrotatedContents << unrotatedContents;
     _filePath  = filePath;
     _csiKey    = csiKey;
     _modified  = false;
@@ -162,13 +416,19 @@ ViewerStep::ViewerStep(const QStringList &rotatedContents,
 void LDrawFile::empty()
 {
   _subFiles.clear();
+  _subFileHandles.fill(nullptr);
+  _subFileHandlesBase = nullptr;
   _subFileOrder.clear();
   _viewerSteps.clear();
+  _viewerStepLast.clear();
+  _viewerStepCache.clear();
   _buildMods.clear();
   _buildModList.clear();
   _loadedParts.clear();
   _mpd = false;
   _partCount = 0;
+  _subFileRefsChanged = true;
+  _subFileRefsCounted = false;
 }
 
 /* Add a new subFile */
@@ -187,25 +447,106 @@ void LDrawFile::insert(const QString &mcFileName,
     _subFiles.erase(i);
   }
   LDrawSubFile subFile(contents,datetime,unofficialPart,generated,subFilePath);
-  _subFiles.insert(fileName,subFile);
+  if (! _tokenizeDeferred)
+    subFile.tokenize();
+  i = _subFiles.insert(fileName,subFile);
+
+  // a name keeps its handle for the session so a reloaded or
+  // replaced subfile is still found through existing Wheres
+  int handle = _subFileHandleIds.value(fileName, -1);
+  if (handle < 0) {
+    handle = _subFileHandles.size();
+    _subFileHandles.append(nullptr);
+    _subFileHandleIds.insert(fileName, handle);
+  }
+  _subFileHandles[handle] = &i.value();
+  // find/insert detach the map when it is shared with a copy, which moves
+  // every node - retake all handles on the next lookup
+  _subFileHandlesBase = nullptr;
   _subFileOrder << fileName;
+  _subFileRefsChanged = true;
 }
 
 /* return the number of lines in the file */
 
+static int subFileSize(const LDrawSubFile *f)
+{
+  if (! f)
+    return 0;
+  if (f->_packed)
+    return f->_packedOffsets.size();
+  return f->_contents.size();
+}
+
 int LDrawFile::size(const QString &mcFileName)
 {
-  QString fileName = mcFileName.toLower();
-  int mySize;
-      
-  QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
+  return subFileSize(subFile(mcFileName));
+}
 
-  if (i == _subFiles.end()) {
-    mySize = 0;
-  } else {
-    mySize = i.value()._contents.size();
+int LDrawFile::size(const Where &here)
+{
+  return subFileSize(subFile(subFileHandle(here)));
+}
+
+/* Submodel handles index _subFileHandles. Names are case folded
+ * once and the handle is remembered for the spelling used, a Where
+ * also keeps the handle for as long as its modelName is unchanged.
+ */
+
+int LDrawFile::subFileHandle(const QString &mcFileName)
+{
+  QHash<QString, int>::const_iterator i = _subFileHandleNames.constFind(mcFileName);
+  if (i != _subFileHandleNames.constEnd())
+    return i.value();
+
+  int handle = _subFileHandleIds.value(mcFileName.toLower(), -1);
+  if (handle >= 0)
+    _subFileHandleNames.insert(mcFileName, handle);
+  return handle;
+}
+
+/* The handles point into the _subFiles nodes. A copy of this LDrawFile
+ * (see Gui::getLDrawFile) shares those nodes until one side detaches, so
+ * the pointers are taken again whenever the map is shared or its nodes
+ * have moved.
+ *
+ * Lookups are not read only: they may detach _subFiles, retake the
+ * handles and cache the name spelling. Even readLine and getMetaArgv
+ * therefore need the LDrawFile to be used by one thread only - the GUI
+ * thread for gui->ldrawFile, a worker's own copy otherwise.
+ */
+
+LDrawSubFile *LDrawFile::subFile(int handle)
+{
+  if (handle < 0 || handle >= _subFileHandles.size())
+    return nullptr;
+  if (! _subFiles.isDetached() ||
+      (_subFiles.isEmpty() ? nullptr : &*_subFiles.constBegin()) != _subFileHandlesBase)
+    resolveSubFileHandles();
+  return _subFileHandles[handle];
+}
+
+void LDrawFile::resolveSubFileHandles()
+{
+  _subFiles.detach();
+  _subFileHandles.fill(nullptr);
+  QHash<QString, int>::const_iterator i = _subFileHandleIds.constBegin();
+  for (; i != _subFileHandleIds.constEnd(); ++i) {
+    QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(i.key());
+    if (f != _subFiles.end())
+      _subFileHandles[i.value()] = &f.value();
+  }
+  _subFileHandlesBase = _subFiles.isEmpty() ? nullptr : &*_subFiles.constBegin();
+}
+
+int LDrawFile::subFileHandle(const Where &here)
+{
+  if (here.modelHandle < 0 ||
+      here.handleName.constData() != here.modelName.constData()) {
+    here.modelHandle = subFileHandle(here.modelName);
+    here.handleName  = here.modelName;
   }
-  return mySize;
+  return here.modelHandle;
 }
 
 bool LDrawFile::isMpd()
@@ -245,14 +586,14 @@ int LDrawFile::fileOrderIndex(const QString &file)
   return -1;
 }
 
-/* return the number of steps within the file */
+/* return the number of steps within the file - step positions are not
+ * indexed, findPage locates them during traversal */
 
 int LDrawFile::numSteps(const QString &mcFileName)
 {
-  QString fileName = mcFileName.toLower();
-  QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
-  if (i != _subFiles.end()) {
-    return i.value()._numSteps;
+  LDrawSubFile *f = countedSubFile(mcFileName);
+  if (f) {
+    return f->_numSteps;
   }
   return 0;
 }
@@ -281,20 +622,14 @@ QDateTime LDrawFile::lastModified(const QString &mcFileName)
 
 bool LDrawFile::contains(const QString &file)
 {
-  for (int i = 0; i < _subFileOrder.size(); i++) {
-    if (_subFileOrder[i].toLower() == file.toLower()) {
-      return true;
-    }
-  }
-  return false;
+  return subFile(file) != nullptr;
 }
 
 bool LDrawFile::isSubmodel(const QString &file)
 {
-  QString fileName = file.toLower();
-  QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
-  if (i != _subFiles.end()) {
-      return ! i.value()._unofficialPart && ! i.value()._generated;
+  LDrawSubFile *f = subFile(file);
+  if (f) {
+      return ! f->_unofficialPart && ! f->_generated;
       //return ! i.value()._generated; // added on revision 368 - to generate csiSubModels for 3D render
   }
   return false;
@@ -327,6 +662,7 @@ QStringList LDrawFile::contents(const QString &mcFileName)
   QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
 
   if (i != _subFiles.end()) {
+    i.value().unpack();
     return i.value()._contents;
   } else {
     return _emptyList;
@@ -342,8 +678,19 @@ void LDrawFile::setContents(const QString     &mcFileName,
   if (i != _subFiles.end()) {
     i.value()._modified = true;
     //i.value()._datetime = QDateTime::currentDateTime();
+    i.value()._packed = false;
+    i.value()._packedContents.clear();
+    i.value()._packedOffsets.clear();
     i.value()._contents = contents;
+    i.value()._lines.clear();
+    i.value()._lines.reserve(contents.size());
+    foreach (const QString &line, contents) {
+      i.value()._lines.append(LDrawLine(line));
+    }
     i.value()._changedSinceLastWrite = true;
+    i.value()._subFileRefsChanged = true;
+    i.value()._buildModsChanged = true;
+    gui->clearPageCheckpoints(fileName, 0);
   }
 }
 
@@ -529,16 +876,63 @@ void LDrawFile::resetLineTypeRelativeIndex(const QString &mcFileName) {
     }
 }
 
+static QString subFileLine(const LDrawSubFile *f, int lineNumber)
+{
+  if (f) {
+      if (f->_packed) {
+          if (lineNumber < f->_packedOffsets.size())
+              return f->packedLine(lineNumber);
+      } else if (lineNumber < f->_contents.size())
+          return f->_contents[lineNumber];
+  }
+  return QString();
+}
+
 QString LDrawFile::readLine(const QString &mcFileName, int lineNumber)
 {
-  QString fileName = mcFileName.toLower();
-  QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
+  return subFileLine(subFile(mcFileName), lineNumber);
+}
 
-  if (i != _subFiles.end()) {
-      if (lineNumber < i.value()._contents.size())
-          return i.value()._contents[lineNumber];
+QString LDrawFile::readLine(const Where &here)
+{
+  return subFileLine(subFile(subFileHandle(here)), here.lineNumber);
+}
+
+/* The meta tokens of a line are only handed out while the line
+ * still reads as it did when they were stored; edits replace the
+ * LDrawLine and drop them.
+ */
+
+bool LDrawFile::getMetaArgv(const Where &here, const QString &line, QStringList &argv)
+{
+  LDrawSubFile *f = subFile(subFileHandle(here));
+  int lineNumber = here.lineNumber;
+
+  if (f && ! f->_packed) {
+      if (lineNumber >= 0 && lineNumber < f->_lines.size()) {
+          const LDrawLine &ldrawLine = f->_lines[lineNumber];
+          if (ldrawLine._metaCompiled && f->_contents[lineNumber] == line) {
+              argv = ldrawLine._metaArgv;
+              return true;
+          }
+      }
+  }
+  return false;
+}
+
+void LDrawFile::setMetaArgv(const Where &here, const QString &line, const QStringList &argv)
+{
+  LDrawSubFile *f = subFile(subFileHandle(here));
+  int lineNumber = here.lineNumber;
+
+  if (f && ! f->_packed) {
+      if (lineNumber >= 0 && lineNumber < f->_lines.size() &&
+          f->_contents[lineNumber] == line) {
+          LDrawLine &ldrawLine = f->_lines[lineNumber];
+          ldrawLine._metaArgv = argv;
+          ldrawLine._metaCompiled = true;
+      }
   }
-  return QString();
 }
 
 void LDrawFile::insertLine(const QString &mcFileName, int lineNumber, const QString &line)
@@ -547,10 +941,15 @@ void LDrawFile::insertLine(const QString &mcFileName, int lineNumber, const QStr
   QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
 
   if (i != _subFiles.end()) {
+    i.value().unpack();
     i.value()._contents.insert(lineNumber,line);
+    i.value()._lines.insert(lineNumber,LDrawLine(line));
     i.value()._modified = true;
  //   i.value()._datetime = QDateTime::currentDateTime();
     i.value()._changedSinceLastWrite = true;
+    i.value()._subFileRefsChanged = true;
+    i.value()._buildModsChanged = true;
+    gui->clearPageCheckpoints(fileName, lineNumber);
   }
 }
   
@@ -560,10 +959,15 @@ void LDrawFile::replaceLine(const QString &mcFileName, int lineNumber, const QSt
   QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
 
   if (i != _subFiles.end()) {
+    i.value().unpack();
     i.value()._contents[lineNumber] = line;
+    i.value()._lines[lineNumber] = LDrawLine(line);
     i.value()._modified = true;
 //    i.value()._datetime = QDateTime::currentDateTime();
     i.value()._changedSinceLastWrite = true;
+    i.value()._subFileRefsChanged = true;
+    i.value()._buildModsChanged = true;
+    gui->clearPageCheckpoints(fileName, lineNumber);
   }
 }
 
@@ -573,10 +977,15 @@ void LDrawFile::deleteLine(const QString &mcFileName, int lineNumber)
   QMap<QString, LDrawSubFile>::iterator i = _subFiles.find(fileName);
 
   if (i != _subFiles.end()) {
+    i.value().unpack();
     i.value()._contents.removeAt(lineNumber);
+    i.value()._lines.remove(lineNumber);
     i.value()._modified = true;
 //    i.value()._datetime = QDateTime::currentDateTime();
     i.value()._changedSinceLastWrite = true;
+    i.value()._subFileRefsChanged = true;
+    i.value()._buildModsChanged = true;
+    gui->clearPageCheckpoints(fileName, lineNumber);
   }
 }
 
@@ -668,6 +1077,44 @@ bool LDrawFile::rendered(
   return rendered;
 }      
 
+/* return the rendered flags of all subfiles entered so far */
+
+QHash<QString, RenderedState> LDrawFile::getRenderedState()
+{
+  QHash<QString, RenderedState> renderedState;
+  QMap<QString, LDrawSubFile>::const_iterator i = _subFiles.constBegin();
+  while (i != _subFiles.constEnd()) {
+    if (i.value()._rendered || i.value()._mirrorRendered) {
+      RenderedState state;
+      state._rendered           = i.value()._rendered;
+      state._mirrorRendered     = i.value()._mirrorRendered;
+      state._renderedKeys       = i.value()._renderedKeys;
+      state._mirrorRenderedKeys = i.value()._mirrorRenderedKeys;
+      renderedState.insert(i.key(),state);
+    }
+    ++i;
+  }
+  return renderedState;
+}
+
+/* reset the rendered flags to a previously captured state */
+
+void LDrawFile::setRenderedState(const QHash<QString, RenderedState> &renderedState)
+{
+  unrendered();
+  QHash<QString, RenderedState>::const_iterator i = renderedState.constBegin();
+  while (i != renderedState.constEnd()) {
+    QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(i.key());
+    if (f != _subFiles.end()) {
+      f.value()._rendered           = i.value()._rendered;
+      f.value()._mirrorRendered     = i.value()._mirrorRendered;
+      f.value()._renderedKeys       = i.value()._renderedKeys;
+      f.value()._mirrorRenderedKeys = i.value()._mirrorRenderedKeys;
+    }
+    ++i;
+  }
+}
+
 int LDrawFile::instances(const QString &mcFileName, bool mirrored)
 {
   QString fileName = mcFileName.toLower();
@@ -685,6 +1132,204 @@ int LDrawFile::instances(const QString &mcFileName, bool mirrored)
   return instances;
 }
 
+/* Tokenize the subfiles inserted while _tokenizeDeferred was set */
+
+void LDrawFile::tokenizeSubFiles()
+{
+    QList<LDrawSubFile *> untokenized;
+    QMap<QString, LDrawSubFile>::iterator f = _subFiles.begin();
+    for (; f != _subFiles.end(); ++f) {
+        if (! f->_packed && f->_lines.size() != f->_contents.size())
+            untokenized << &f.value();
+    }
+    QtConcurrent::blockingMap(untokenized, tokenizeSubFile);
+    _tokenizeDeferred = false;
+    _subFileHandlesBase = nullptr;
+}
+
+/*
+ * Load snapshots keep the subfiles a model load produced so reopening
+ * the same content skips the MPD and LDR loaders. The snapshot name is
+ * a hash of the model file path followed by a hash of its content, the
+ * search settings and the parts archives subfiles resolve against;
+ * subfiles and staged files that were read from their own files must
+ * still carry the recorded modification time. Anything else that does
+ * not match falls back to a full load. Only the latest snapshot of a
+ * model path is kept, and at most LOAD_SNAPSHOT_MAX_FILES in all.
+ */
+
+#define LOAD_SNAPSHOT_MAGIC     0x4C505353 // LPSS
+#define LOAD_SNAPSHOT_VERSION   2
+#define LOAD_SNAPSHOT_MAX_FILES 32
+
+static QString loadSnapshotFile(const QString &fileName, const QByteArray &content)
+{
+    QByteArray pathHash = QCryptographicHash::hash(QFileInfo(fileName).absoluteFilePath().toUtf8(),
+                                                   QCryptographicHash::Sha1).toHex();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(content);
+    hash.addData(QDir::toNativeSeparators(Preferences::ldrawLibPath).toUtf8());
+    hash.addData(Preferences::ldSearchDirs.join("|").toUtf8());
+    hash.addData(Preferences::extendedSubfileSearch ? "1" : "0");
+    QFileInfo officialArchive(QDir::toNativeSeparators(Preferences::lpub3dLibFile));
+    QFileInfo customArchive(QString("%1/%2").arg(officialArchive.absolutePath(),Preferences::validLDrawCustomArchive));
+    foreach (const QFileInfo &archive, QList<QFileInfo>() << officialArchive << customArchive) {
+        hash.addData(archive.absoluteFilePath().toUtf8());
+        hash.addData(archive.lastModified().toString(Qt::ISODate).toUtf8());
+    }
+    return QDir::toNativeSeparators(QString("%1/cache/snapshots/%2_%3.lss")
+                                    .arg(Preferences::lpubDataPath)
+                                    .arg(QString(pathHash))
+                                    .arg(QString(hash.result().toHex())));
+}
+
+/* Remove the older snapshots of the model path and the oldest beyond the cap */
+
+static void evictLoadSnapshots(const QString &snapshotFile)
+{
+    QFileInfo snapshotInfo(snapshotFile);
+    QString pathPrefix = snapshotInfo.fileName().section('_', 0, 0) + "_";
+    QDir snapshotDir(snapshotInfo.absolutePath());
+    QFileInfoList snapshots = snapshotDir.entryInfoList(QStringList() << "*.lss", QDir::Files, QDir::Time);
+    int kept = 0;
+    foreach (const QFileInfo &snapshot, snapshots) {
+        if (snapshot.fileName() == snapshotInfo.fileName())
+            continue;
+        if (snapshot.fileName().startsWith(pathPrefix) || ++kept >= LOAD_SNAPSHOT_MAX_FILES)
+            QFile::remove(snapshot.absoluteFilePath());
+    }
+}
+
+bool LDrawFile::readLoadSnapshot(const QString &snapshotFile, const QDateTime &datetime)
+{
+    QFile file(snapshotFile);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray buffer;
+    uchar *map = file.size() > 0 ? file.map(0, file.size()) : nullptr;
+    if (map)
+        buffer = QByteArray::fromRawData(reinterpret_cast<const char *>(map), int(file.size()));
+    else
+        buffer = file.readAll();
+
+    QDataStream in(buffer);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != LOAD_SNAPSHOT_MAGIC || version != LOAD_SNAPSHOT_VERSION)
+        return false;
+
+    bool mpd;
+    QString name, author, description, category, topFile;
+    QMultiHash<QString, int> ldcadGroups;
+    in >> mpd >> topFile >> name >> author >> description >> category >> ldcadGroups;
+
+    qint32 numSubFiles;
+    in >> numSubFiles;
+    QList<QStringList> subFileContents;
+    QStringList subFileNames, subFilePaths;
+    QList<QDateTime> subFileDates;
+    QList<bool> subFileUnofficial;
+    for (qint32 i = 0; i < numSubFiles && in.status() == QDataStream::Ok; i++) {
+        QString subFileName, subFilePath;
+        QStringList contents;
+        QDateTime subFileDate, lastModified;
+        bool unofficial;
+        in >> subFileName >> contents >> subFileDate >> unofficial >> subFilePath >> lastModified;
+        if (! subFilePath.isEmpty() && QFileInfo(subFilePath).lastModified() != lastModified)
+            return false;
+        subFileNames << subFileName;
+        subFileContents << contents;
+        subFileDates << (subFilePath.isEmpty() ? datetime : subFileDate);
+        subFileUnofficial << unofficial;
+        subFilePaths << subFilePath;
+    }
+    qint32 numStagedFiles;
+    in >> numStagedFiles;
+    for (qint32 i = 0; i < numStagedFiles && in.status() == QDataStream::Ok; i++) {
+        QString stagedFile;
+        QDateTime lastModified;
+        in >> stagedFile >> lastModified;
+        if (QFileInfo(stagedFile).lastModified() != lastModified)
+            return false;
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    _tokenizeDeferred = true;
+    for (int i = 0; i < subFileNames.size(); i++) {
+        insert(subFileNames[i],subFileContents[i],subFileDates[i],subFileUnofficial[i],false,subFilePaths[i]);
+    }
+    tokenizeSubFiles();
+
+    QMultiHash<QString, int>::const_iterator g = ldcadGroups.constBegin();
+    for (; g != ldcadGroups.constEnd(); ++g) {
+        insertLDCadGroup(g.key(),g.value());
+    }
+
+    _mpd         = mpd;
+    _file        = topFile;
+    _name        = name;
+    _author      = author;
+    _description = description;
+    _category    = category;
+    if (_mpd) {
+        if (! _author.isEmpty())
+            Preferences::defaultAuthor = _author;
+        if (! _description.isEmpty())
+            Preferences::publishDescription = _description;
+    }
+
+    if (map)
+        file.unmap(map);
+    return true;
+}
+
+void LDrawFile::writeLoadSnapshot(const QString &snapshotFile)
+{
+    if (_loadUnresolved || _subFileOrder.isEmpty())
+        return;
+    for (int i = 0; i < _subFileOrder.size(); i++) {
+        if (! _subFiles.contains(_subFileOrder[i]))
+            return;
+    }
+
+    QDir().mkpath(QFileInfo(snapshotFile).absolutePath());
+    QSaveFile file(snapshotFile);
+    if (!file.open(QFile::WriteOnly)) {
+        emit gui->messageSig(LOG_NOTICE, QString("Cannot write load snapshot %1: %2.")
+                             .arg(snapshotFile)
+                             .arg(file.errorString()));
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(LOAD_SNAPSHOT_MAGIC) << quint32(LOAD_SNAPSHOT_VERSION);
+    out << _mpd << _file << _name << _author << _description << _category << _ldcadGroups;
+    out << qint32(_subFileOrder.size());
+    for (int i = 0; i < _subFileOrder.size(); i++) {
+        QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(_subFileOrder[i]);
+        const QString &subFilePath = f->_subFilePath;
+        out << _subFileOrder[i] << f->_contents << f->_datetime << bool(f->_unofficialPart) << subFilePath
+            << (subFilePath.isEmpty() ? QDateTime() : QFileInfo(subFilePath).lastModified());
+    }
+    out << qint32(_loadStagedFiles.size());
+    foreach (const QString &stagedFile, _loadStagedFiles) {
+        out << stagedFile << QFileInfo(stagedFile).lastModified();
+    }
+    if (!file.commit()) {
+        emit gui->messageSig(LOG_NOTICE, QString("Cannot write load snapshot %1: %2.")
+                             .arg(snapshotFile)
+                             .arg(file.errorString()));
+        return;
+    }
+
+    evictLoadSnapshots(snapshotFile);
+}
+
 int LDrawFile::loadFile(const QString &fileName)
 {
     QFile file(fileName);
@@ -699,12 +1344,20 @@ int LDrawFile::loadFile(const QString &fileName)
 
     QTime t; t.start();
 
-    // check file encoding
-    QTextCodec::ConverterState state;
-    QTextCodec *codec = QTextCodec::codecForName("UTF-8");
-    QString utfTest = codec->toUnicode(qba.constData(), qba.size(), &state);
-    _currFileIsUTF8 = state.invalidChars == 0;
-    utfTest = QString();
+    // check file encoding - plain ASCII is valid UTF-8 without a decode test
+    const char *byte = qba.constData();
+    const char *end  = byte + qba.size();
+    while (byte < end && ! (uchar(*byte) & 0x80))
+        ++byte;
+    if (byte == end) {
+        _currFileIsUTF8 = true;
+    } else {
+        QTextCodec::ConverterState state;
+        QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+        QString utfTest = codec->toUnicode(qba.constData(), qba.size(), &state);
+        _currFileIsUTF8 = state.invalidChars == 0;
+        utfTest = QString();
+    }
 
     // get rid of what's there before we load up new stuff
 
@@ -738,13 +1391,23 @@ int LDrawFile::loadFile(const QString &fileName)
     QApplication::setOverrideCursor(Qt::WaitCursor);
 
     ldcadGroupsLoaded = false;
+    _loadUnresolved   = false;
+    _loadStagedFiles.clear();
 
-    if (mpd) {
-      QDateTime datetime = QFileInfo(fileName).lastModified();
-      loadMPDFile(QDir::toNativeSeparators(fileName),datetime);
+    QString snapshotFile = loadSnapshotFile(fileName,qba);
+    qba.clear();
+
+    if (readLoadSnapshot(snapshotFile,fileInfo.lastModified())) {
+      emit gui->messageSig(LOG_INFO, QString("Model file %1 restored from load snapshot.").arg(fileInfo.fileName()));
     } else {
-      topLevelModel = true;
-      loadLDRFile(QDir::toNativeSeparators(fileInfo.absolutePath()),fileInfo.fileName());
+      if (mpd) {
+        QDateTime datetime = QFileInfo(fileName).lastModified();
+        loadMPDFile(QDir::toNativeSeparators(fileName),datetime);
+      } else {
+        topLevelModel = true;
+        loadLDRFile(QDir::toNativeSeparators(fileInfo.absolutePath()),fileInfo.fileName());
+      }
+      writeLoadSnapshot(snapshotFile);
     }
     
     QApplication::restoreOverrideCursor();
@@ -852,6 +1515,171 @@ void LDrawFile::showLoadMessages()
         LdrawFilesLoad::showLoadMessages(_loadedParts);
 }
 
+/*
+ * Append the trimmed lines of an open file to lines. The file is mapped
+ * when possible and split on newlines at byte level so each line is
+ * decoded just once. Data with a UTF-16 or UTF-32 byte order mark, or
+ * without any newline, e.g. lone carriage return line ends, is left to
+ * QTextStream.
+ */
+
+static void readStageLines(QFile &file, bool utf8, QStringList &lines)
+{
+    QByteArray buffer;
+    qint64 size = file.size();
+    uchar *map = size > 0 ? file.map(0, size) : nullptr;
+    const char *data = reinterpret_cast<const char *>(map);
+    if (! map) {
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    QTextCodec *codec = utf8 ? QTextCodec::codecForName("UTF-8") : QTextCodec::codecForName("System");
+    const char *end = data + size;
+    const char *sol = data;
+
+    bool wideBom = (size >= 2 && (memcmp(sol, "\xFF\xFE", 2) == 0 || memcmp(sol, "\xFE\xFF", 2) == 0)) ||
+                   (size >= 4 && memcmp(sol, "\x00\x00\xFE\xFF", 4) == 0);
+    if (wideBom || ! memchr(sol, '\n', size_t(size))) {
+        QByteArray rawData = QByteArray::fromRawData(data, int(size));
+        QTextStream in(&rawData, QIODevice::ReadOnly);
+        in.setCodec(codec);
+        while ( ! in.atEnd()) {
+            QString sLine = in.readLine(0);
+            lines << sLine.trimmed();
+        }
+    } else {
+        if (utf8 && size >= 3 && memcmp(sol, "\xEF\xBB\xBF", 3) == 0)
+            sol += 3;
+
+        while (sol < end) {
+            const char *eol = static_cast<const char *>(memchr(sol, '\n', size_t(end - sol)));
+            if (! eol)
+                eol = end;
+            lines << codec->toUnicode(sol, int(eol - sol)).trimmed();
+            sol = eol + 1;
+        }
+    }
+
+    if (map)
+        file.unmap(map);
+}
+
+/*
+ * What the MPD loader needs to know about each staged line. Working it
+ * out has no ordering dependencies, so the submodels of a staged range
+ * are scanned concurrently; loadMPDContents then walks the results in
+ * file order to capture the header, insert the subfiles and intern the
+ * part names exactly as a serial load would.
+ */
+
+struct StageLineScan
+{
+    enum {
+        MetaLine  = 0x001,
+        StartFile = 0x002,
+        EndFile   = 0x004,
+        Author    = 0x008,
+        Name      = 0x010,
+        Category  = 0x020,
+        GroupDef  = 0x040,
+        StepLine  = 0x080,
+        PartLine  = 0x100
+    };
+    StageLineScan() : flags(0), unofficial(UNOFFICIAL_SUBMODEL) {}
+    int     flags;
+    int     unofficial;   // unofficial file type of a meta line
+    QString partName;     // type 1 line part name as written
+    QString subfileName;  // referenced subfile or substitute part
+};
+
+struct StageSegment
+{
+    const QStringList *lines;
+    StageLineScan     *scan;   // scan of lines[base]
+    int                base;
+    int                begin;
+    int                end;
+};
+
+static void scanStageSegment(StageSegment &segment)
+{
+    QRegExp sofRE("^0\\s+FILE\\s+(.*)$",Qt::CaseInsensitive);
+    QRegExp eofRE("^0\\s+NOFILE\\s*$",Qt::CaseInsensitive);
+
+    QRegExp upAUT("^0\\s+Author:?\\s+(.*)$",Qt::CaseInsensitive);
+    QRegExp upNAM("^0\\s+Name:?\\s+(.*)$",Qt::CaseInsensitive);
+    QRegExp upCAT("^0\\s+!?CATEGORY\\s+(.*)$",Qt::CaseInsensitive);
+
+    QRegExp ldcGRP( "^\\s*0\\s+!?LDCAD\\s+GROUP_DEF.*\\s+\\[LID=(\\d+)\\]\\s+\\[GID=([\\d\\w]+)\\]\\s+\\[name=(.[^\\]]+)\\].*$");
+
+    for (int i = segment.begin; i < segment.end; i++) {
+        QString smLine = segment.lines->at(i);
+        StageLineScan &scan = segment.scan[i - segment.base];
+
+        // the patterns below only match comment lines, the keyword
+        // checks keep the expressions off all other lines
+        if (smLine.startsWith('0')) {
+            scan.flags |= StageLineScan::MetaLine;
+            if (smLine.contains("FILE",Qt::CaseInsensitive)) {
+                if (smLine.contains(sofRE))
+                    scan.flags |= StageLineScan::StartFile;
+                else if (smLine.contains(eofRE))
+                    scan.flags |= StageLineScan::EndFile;
+            }
+            if (smLine.contains(upAUT))
+                scan.flags |= StageLineScan::Author;
+            if (smLine.contains(upNAM))
+                scan.flags |= StageLineScan::Name;
+            if (smLine.contains(upCAT))
+                scan.flags |= StageLineScan::Category;
+            if (smLine.contains("GROUP_DEF") && smLine.contains(ldcGRP))
+                scan.flags |= StageLineScan::GroupDef;
+            else if (smLine.contains("0 STEP"))
+                scan.flags |= StageLineScan::StepLine;
+            scan.unofficial = getUnofficialFileType(smLine);
+        }
+
+        QStringList tokens;
+        split(smLine,tokens);
+
+        if (tokens.size() == 15 && tokens.at(0) == "1") {
+            scan.flags |= StageLineScan::PartLine;
+            scan.partName = tokens.at(14);
+            scan.subfileName = scan.partName.toLower();
+        } else if (scan.flags & StageLineScan::MetaLine) {
+            isSubstitute(smLine,scan.subfileName);
+        }
+    }
+}
+
+/*
+ * Scan the staged lines from begin on, one segment per FILE section.
+ * The returned vector holds the scan of lines[begin] at index 0.
+ */
+
+static QVector<StageLineScan> scanStageLines(const QStringList &lines, int begin)
+{
+    QVector<StageLineScan> scan(qMax(0, lines.size() - begin));
+    QList<StageSegment> segments;
+    StageSegment segment = { &lines, scan.data(), begin, begin, begin };
+    for (int i = begin; i < lines.size(); i++) {
+        const QString &line = lines.at(i);
+        if (i > segment.begin && line.startsWith('0') && line.contains("FILE",Qt::CaseInsensitive)) {
+            segment.end = i;
+            segments << segment;
+            segment.begin = i;
+        }
+    }
+    segment.end = lines.size();
+    if (segment.end > segment.begin)
+        segments << segment;
+
+    QtConcurrent::blockingMap(segments, scanStageSegment);
+    return scan;
+}
+
 void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
 {    
     QFile file(fileName);
@@ -863,19 +1691,18 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
     }
 
     QFileInfo   fileInfo(fileName);
-    QTextStream in(&file);
-    in.setCodec(_currFileIsUTF8 ? QTextCodec::codecForName("UTF-8") : QTextCodec::codecForName("System"));
+
+    // submodels are tokenized concurrently once the whole file is staged
+    _tokenizeDeferred = true;
 
     QStringList stageContents;
     QStringList stageSubfiles;
+    QHash<QString, QString> stageSubfilePaths;
 
     /* Read it in the first time to put into fileList in order of
      appearance */
 
-    while ( ! in.atEnd()) {
-        QString sLine = in.readLine(0);
-        stageContents << sLine.trimmed();
-    }
+    readStageLines(file, _currFileIsUTF8, stageContents);
     file.close();
 
     topLevelFileNotCaptured        = true;
@@ -887,19 +1714,6 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
     topLevelModel                  = true;
     descriptionLine                = 0;
 
-    QStringList searchPaths = Preferences::ldSearchDirs;
-    QString ldrawPath = QDir::toNativeSeparators(Preferences::ldrawLibPath);
-    if (!searchPaths.contains(ldrawPath + QDir::separator() + "MODELS",Qt::CaseInsensitive))
-        searchPaths.append(ldrawPath + QDir::separator() + "MODELS");
-    if (!searchPaths.contains(ldrawPath + QDir::separator() + "PARTS",Qt::CaseInsensitive))
-        searchPaths.append(ldrawPath + QDir::separator() + "PARTS");
-    if (!searchPaths.contains(ldrawPath + QDir::separator() + "P",Qt::CaseInsensitive))
-        searchPaths.append(ldrawPath + QDir::separator() + "P");
-    if (!searchPaths.contains(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "PARTS",Qt::CaseInsensitive))
-        searchPaths.append(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "PARTS");
-    if (!searchPaths.contains(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "P",Qt::CaseInsensitive))
-        searchPaths.append(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "P");
-
     std::function<QString()> modelType;
     modelType = [this] ()
     {
@@ -914,14 +1728,13 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
             &loadMPDContents,
             &stageContents,
             &stageSubfiles,
+            &stageSubfilePaths,
             &fileInfo,
-            &searchPaths,
             &datetime] (int i) {
         bool alreadyLoaded;
         QStringList contents;
         QString     subfileName;
         QRegExp sofRE("^0\\s+FILE\\s+(.*)$",Qt::CaseInsensitive);
-        QRegExp eofRE("^0\\s+NOFILE\\s*$",Qt::CaseInsensitive);
 
         QRegExp upAUT("^0\\s+Author:?\\s+(.*)$",Qt::CaseInsensitive);
         QRegExp upNAM("^0\\s+Name:?\\s+(.*)$",Qt::CaseInsensitive);
@@ -929,6 +1742,10 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
 
         QRegExp ldcGRP( "^\\s*0\\s+!?LDCAD\\s+GROUP_DEF.*\\s+\\[LID=(\\d+)\\]\\s+\\[GID=([\\d\\w]+)\\]\\s+\\[name=(.[^\\]]+)\\].*$");
 
+        int progressStep = qMax(1, stageContents.size() / 100);
+        int scanBase = i;
+        const QVector<StageLineScan> stageScan = scanStageLines(stageContents, scanBase);
+
         emit gui->progressBarPermInitSig();
         emit gui->progressPermRangeSig(1, stageContents.size());
         emit gui->progressPermMessageSig("Processing " + modelType() + " file " + fileInfo.fileName() + "...");
@@ -940,32 +1757,31 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
         for (; i < stageContents.size(); i++) {
 
             QString smLine = stageContents.at(i);
+            const StageLineScan &scan = stageScan.at(i - scanBase);
 
-            emit gui->progressPermSetValueSig(i);
+            if (i % progressStep == 0)
+                emit gui->progressPermSetValueSig(i);
 
-            bool sof = smLine.contains(sofRE);  //start of file
-            bool eof = smLine.contains(eofRE);  //end of file
+            // the captures are taken again for the few lines that are used
+            bool metaLine = scan.flags & StageLineScan::MetaLine;
+            bool sof = scan.flags & StageLineScan::StartFile;  //start of file
+            bool eof = scan.flags & StageLineScan::EndFile;    //end of file
+            if (sof)
+                smLine.contains(sofRE);
 
             // load LDCad groups
-            if (!ldcadGroupsLoaded && smLine.contains(ldcGRP)){
-               insertLDCadGroup(ldcGRP.cap(3),ldcGRP.cap(1).toInt());
-               insertLDCadGroup(ldcGRP.cap(2),ldcGRP.cap(1).toInt());
-            } else if (smLine.contains("0 STEP")) {
-               ldcadGroupsLoaded = true;
+            if (!ldcadGroupsLoaded) {
+                if ((scan.flags & StageLineScan::GroupDef) && smLine.contains(ldcGRP)){
+                   insertLDCadGroup(ldcGRP.cap(3),ldcGRP.cap(1).toInt());
+                   insertLDCadGroup(ldcGRP.cap(2),ldcGRP.cap(1).toInt());
+                } else if (scan.flags & StageLineScan::StepLine) {
+                   ldcadGroupsLoaded = true;
+                }
             }
 
-            QStringList tokens;
-            split(smLine,tokens);
-
             // subfile check;
-            QString stageSubfileName;
-            bool subFileFound = false;
-            if ((subFileFound = tokens.size() == 15 && tokens.at(0) == "1")) {
-                stageSubfileName = tokens.at(14).toLower();
-            } else if (isSubstitute(smLine,stageSubfileName)) {
-                subFileFound = !stageSubfileName.isEmpty();
-            }
-            if (subFileFound) {
+            const QString &stageSubfileName = scan.subfileName;
+            if (! stageSubfileName.isEmpty()) {
                 PieceInfo* standardPart = lcGetPiecesLibrary()->FindPiece(stageSubfileName.toLatin1().constData(), nullptr, false, false);
                 if (! standardPart && ! LDrawFile::contains(stageSubfileName.toLower()) && ! stageSubfiles.contains(stageSubfileName)) {
                     stageSubfiles.append(stageSubfileName);
@@ -980,7 +1796,7 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
                 }
             }
 
-            if (topLevelAuthorNotCaptured) {
+            if (topLevelAuthorNotCaptured && (scan.flags & StageLineScan::Author)) {
                 if (smLine.contains(upAUT)) {
                     _author = upAUT.cap(1).replace(": ","");
                     Preferences::defaultAuthor = _author;
@@ -988,14 +1804,14 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
                 }
             }
 
-            if (topLevelNameNotCaptured) {
+            if (topLevelNameNotCaptured && (scan.flags & StageLineScan::Name)) {
                 if (smLine.contains(upNAM)) {
                     _name = upNAM.cap(1).replace(": ","");
                     topLevelNameNotCaptured = false;
                 }
             }
 
-            if (topLevelCategoryNotCaptured && subfileName == topLevelFile()) {
+            if (topLevelCategoryNotCaptured && (scan.flags & StageLineScan::Category) && subfileName == topLevelFile()) {
                 if (smLine.contains(upCAT)) {
                         _category = upCAT.cap(1);
                     topLevelCategoryNotCaptured = false;
@@ -1026,7 +1842,7 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
                     if (! alreadyLoaded) {
                         emit gui->messageSig(LOG_TRACE, QString("MPD " + modelType() + " '" + subfileName + "' with " +
                                                                 QString::number(contents.size()) + " lines loaded."));
-                        insert(subfileName,contents,datetime,unofficialPart);
+                        insert(subfileName,contents,datetime,unofficialPart,false,stageSubfilePaths.value(subfileName));
                         topLevelModel = false;
                         unofficialPart = false;
                     }
@@ -1052,12 +1868,16 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
                  * - if line contains unofficial part/subpart/shortcut/primitive/alias tag set unofficial part = true
                  * - add line to contents
                  */
-                if (! unofficialPart) {
-                    unofficialPart = getUnofficialFileType(smLine);
+                if (! unofficialPart && metaLine) {
+                    unofficialPart = scan.unofficial;
                     if (unofficialPart)
                         emit gui->messageSig(LOG_TRACE, "Submodel '" + subfileName + "' spcified as Unofficial Part.");
                 }
 
+                // intern part names in file order, as a serial load would
+                if ((scan.flags & StageLineScan::PartLine) && ! alreadyLoaded)
+                    LDrawFile::partId(scan.partName);
+
                 contents << smLine;
             }
         }
@@ -1068,7 +1888,7 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
             } else {
                 emit gui->messageSig(LOG_TRACE, QString("MPD submodel '" + subfileName + "' with " +
                                                         QString::number(contents.size()) + " lines loaded."));
-                insert(subfileName,contents,datetime,unofficialPart);
+                insert(subfileName,contents,datetime,unofficialPart,false,stageSubfilePaths.value(subfileName));
             }
             stageSubfiles.removeAt(stageSubfiles.indexOf(subfileName));
         }
@@ -1103,34 +1923,31 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
                 else
                 // extended search - LDraw subfolder paths and extra search directorie paths
                 if (Preferences::extendedSubfileSearch) {
-                    for (QString subFilePath : searchPaths){
-                        if ((subFileFound = QFileInfo(subFilePath + QDir::separator() + subfile).isFile())) {
-                            fileInfo = QFileInfo(subFilePath + QDir::separator() + subfile);
-                            break;
-                        }
-                    }
+                    QString subFilePath = findSubFile(subfile);
+                    if ((subFileFound = !subFilePath.isEmpty()))
+                        fileInfo = QFileInfo(subFilePath);
                 }
 
                 if (!subFileFound) {
+                    _loadUnresolved = true;
                     emit gui->messageSig(LOG_NOTICE, QString("Subfile %1 not found.")
                                          .arg(subfile));
                 } else {
-                    setSubFilePath(subfile,fileInfo.absoluteFilePath());
+                    // the subfile is inserted when its contents are processed below
+                    stageSubfilePaths.insert(subfile.toLower(),fileInfo.absoluteFilePath());
+                    _loadStagedFiles << fileInfo.absoluteFilePath();
                     stageSubfiles.removeAt(stageSubfiles.indexOf(subfile));
                     file.setFileName(fileInfo.absoluteFilePath());
                     if (!file.open(QFile::ReadOnly | QFile::Text)) {
                         emit gui->messageSig(LOG_NOTICE, QString("Cannot read file %1:\n%2.")
                                              .arg(fileInfo.absoluteFilePath())
                                              .arg(file.errorString()));
+                        _loadUnresolved = true;
                         return;
                     }
 
-                    QTextStream in(&file);
-                    in.setCodec(_currFileIsUTF8 ? QTextCodec::codecForName("UTF-8") : QTextCodec::codecForName("System"));
-                    while ( ! in.atEnd()) {
-                        QString sLine = in.readLine(0);
-                        stageContents << sLine.trimmed();
-                    }
+                    readStageLines(file, _currFileIsUTF8, stageContents);
+                    file.close();
                 }
             }
             if (subFileFound) {
@@ -1144,6 +1961,8 @@ void LDrawFile::loadMPDFile(const QString &fileName, QDateTime &datetime)
 
     loadMPDContents(0);
 
+    tokenizeSubFiles();
+
 #ifdef QT_DEBUG_MODE
     QHashIterator<QString, int> i(_ldcadGroups);
     while (i.hasNext()) {
@@ -1214,19 +2033,6 @@ void LDrawFile::loadLDRFile(const QString &path, const QString &fileName)
             descriptionLine                = 0;
         }
 
-        QStringList searchPaths = Preferences::ldSearchDirs;
-        QString ldrawPath = QDir::toNativeSeparators(Preferences::ldrawLibPath);
-        if (!searchPaths.contains(ldrawPath + QDir::separator() + "MODELS",Qt::CaseInsensitive))
-            searchPaths.append(ldrawPath + QDir::separator() + "MODELS");
-        if (!searchPaths.contains(ldrawPath + QDir::separator() + "PARTS",Qt::CaseInsensitive))
-            searchPaths.append(ldrawPath + QDir::separator() + "PARTS");
-        if (!searchPaths.contains(ldrawPath + QDir::separator() + "P",Qt::CaseInsensitive))
-            searchPaths.append(ldrawPath + QDir::separator() + "P");
-        if (!searchPaths.contains(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "PARTS",Qt::CaseInsensitive))
-            searchPaths.append(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "PARTS");
-        if (!searchPaths.contains(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "P",Qt::CaseInsensitive))
-            searchPaths.append(ldrawPath + QDir::separator() + "UNOFFICIAL" + QDir::separator() + "P");
-
         QRegExp upAUT("^0\\s+Author:?\\s+(.*)$",Qt::CaseInsensitive);
         QRegExp upNAM("^0\\s+Name:?\\s+(.*)$",Qt::CaseInsensitive);
         QRegExp upCAT("^0\\s+!?CATEGORY\\s+(.*)$",Qt::CaseInsensitive);
@@ -1317,12 +2123,9 @@ void LDrawFile::loadLDRFile(const QString &path, const QString &fileName)
                     else
                     // extended search - LDraw subfolder paths and extra search directorie paths
                     if (Preferences::extendedSubfileSearch) {
-                        for (QString subFilePath : searchPaths){
-                            if ((subFileFound = QFileInfo(subFilePath + QDir::separator() + subFileInfo.fileName()).isFile())) {
-                                subFileInfo = QFileInfo(subFilePath + QDir::separator() + subFileInfo.fileName());
-                                break;
-                            }
-                        }
+                        QString subFilePath = findSubFile(subFileInfo.fileName());
+                        if ((subFileFound = !subFilePath.isEmpty()))
+                            subFileInfo = QFileInfo(subFilePath);
                     }
 
                     if (subFileFound) {
@@ -1330,6 +2133,7 @@ void LDrawFile::loadLDRFile(const QString &path, const QString &fileName)
                         topLevelModel = false;
                         loadLDRFile(subFileInfo.absolutePath(),subFileInfo.fileName());
                     } else {
+                        _loadUnresolved = true;
                         emit gui->messageSig(LOG_NOTICE, QString("Subfile %1 not found.")
                                              .arg(subFileInfo.fileName()));
                     }
@@ -1396,6 +2200,7 @@ void LDrawFile::addCustomColorParts(const QString &mcFileName,bool autoAdd)
   QString fileName = mcFileName.toLower();
   QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(fileName);
   if (f != _subFiles.end()) {
+    f->unpack();
     // get content size
     int j = f->_contents.size();
     // process submodel content...
@@ -1459,139 +2264,227 @@ void LDrawFile::addCustomColorParts(const QString &mcFileName,bool autoAdd)
   }
 }
 
-void LDrawFile::countInstances(const QString &mcFileName, bool isMirrored, bool callout)
+/*
+ * Scan a single submodel for the submodels it references (its edges in the
+ * submodel graph) and for its number of steps. Only submodels whose contents
+ * changed are scanned - instance counts are then propagated over the graph.
+ */
+void LDrawFile::countSubFileRefs(const QString &mcFileName)
 {
-  //logTrace() << QString("countInstances, File: %1, Mirrored: %2, Callout: %3").arg(mcFileName,(isMirrored?"Yes":"No"),(callout?"Yes":"No"));
-
   QString fileName = mcFileName.toLower();
   bool partsAdded  = false;
   bool noStep      = false;
   bool stepIgnore  = false;
-  
+
   QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(fileName);
   if (f != _subFiles.end()) {
-    // count mirrored instance automatically
-    if (f->_beenCounted) {
-      if (isMirrored) {
-        ++f->_mirrorInstances;
-      } else {
-        ++f->_instances;
-      }
-      return;
-    }
-    // get content size and reset numSteps
-    int j = f->_contents.size();
+    // get content size and reset numSteps and references
+    int j = f->_lines.size();
     f->_numSteps = 0;
+    f->_subFileRefs.clear();
+
+    // build modification levels are local to the submodel
+    buildMod = 0;
+    f->indexBuildMods();
 
     // process submodel content...
     for (int i = 0; i < j; i++) {
-      QStringList tokens;
-      QString line = f->_contents[i];
-      split(line,tokens);
-      
+      const LDrawLine &line = f->_lines[i];
+
       /* Sorry, but models that are callouts are not counted as instances */
           // called out
-      if (tokens.size() == 4 && tokens[0] == "0" &&
-          (tokens[1] == "LPUB" || tokens[1] == "!LPUB") && 
-          tokens[2] == "CALLOUT" && 
-          tokens[3] == "BEGIN") {
+      if (line._op == LDrawLine::CalloutBeginOp) {
         partsAdded = true;
            //process callout content
         for (++i; i < j; i++) {
-          split(f->_contents[i],tokens);
-          if (tokens.size() == 15 && tokens[0] == "1") {
-            if (contains(tokens[14]) && ! stepIgnore) {
-              countInstances(tokens[14],mirrored(tokens),true);
+          const LDrawLine &calloutLine = f->_lines[i];
+          if (calloutLine._partId != -1) {
+            QString partName = LDrawFile::partName(calloutLine._partId).toLower();
+            if (contains(partName) && ! stepIgnore) {
+              f->_subFileRefs.append(SubFileRef(partName,calloutLine._mirrored,true));
             }
-          } else if (tokens.size() == 4 && tokens[0] == "0" &&
-              (tokens[1] == "LPUB" || tokens[1] == "!LPUB") && 
-              tokens[2] == "CALLOUT" && 
-              tokens[3] == "END") {
-            
+          } else if (calloutLine._op == LDrawLine::CalloutEndOp) {
+
             break;
           }
         }
         // build modification - end at action to include original lines
-      } else if (tokens.size() >= 4 && tokens[0] == "0"  &&
-                (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-                 tokens[2] == "BUILD_MOD") {
-        if (tokens[3] == "BEGIN") {
-          buildMod = getLevel(tokens[4],HiarchLevel::BEGIN);
-        } else if (tokens[3] == "APPLY" || tokens[3] == "REMOVE") {
-          buildMod = getLevel(QString(),HiarchLevel::END);
-        }
+      } else if (line._op >= LDrawLine::BuildModBeginOp &&
+                 line._op <= LDrawLine::BuildModOtherOp) {
+        buildMod = buildModLevel(&f.value(), i, BuildModBlock::ActionClose);
         stepIgnore = buildMod;
         //lpub3d ignore part - so set ignore step
-      } else if (tokens.size() == 5 && tokens[0] == "0" &&
-                 (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-                 (tokens[2] == "PART" || tokens[2] == "PLI") &&
-                 tokens[3] == "BEGIN"  &&
-                 tokens[4] == "IGN") {
+      } else if (line._op == LDrawLine::PartIgnoreBeginOp) {
         stepIgnore = true;
         // lpub3d part - so set include step
-      } else if (tokens.size() == 4 && tokens[0] == "0" &&
-                 (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-                 (tokens[2] == "PART" || tokens[2] == "PLI") &&
-                 tokens[3] == "END") {
+      } else if (line._op == LDrawLine::PartIgnoreEndOp) {
         stepIgnore = false;
         // no step
-      } else if (tokens.size() == 3 && tokens[0] == "0" &&
-                (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-                 tokens[2] == "NOSTEP") {
+      } else if (line._op == LDrawLine::NoStepOp) {
         noStep = true;
         // LDraw step or rotstep - so check if parts added
-      } else if (tokens.size() >= 2 && tokens[0] == "0" &&
-                (tokens[1] == "STEP" || tokens[1] == "ROTSTEP")) {
+      } else if (line._op == LDrawLine::StepOp) {
         // parts added - increment step
         if (partsAdded && ! noStep) {
-          int incr = (isMirrored && f->_mirrorInstances == 0) ||
-                     (!isMirrored && f->_instances == 0);
-          f->_numSteps += incr;
+          ++f->_numSteps;
         }
         // reset partsAdded
         partsAdded = false;
         noStep = false;
         // buffer exchange - do nothing
-      } else if (tokens.size() == 4 && tokens[0] == "0"
-                                     && tokens[1] == "BUFEXCHG") {
-        // check if subfile and process
-      } else if (tokens.size() == 15 && tokens[0] == "1") {
-        bool containsSubFile = contains(tokens[14]);
+      } else if (line._op == LDrawLine::BufExchgOp) {
+        // check if subfile and add reference
+      } else if (line._partId != -1) {
+        QString partName = LDrawFile::partName(line._partId).toLower();
+        bool containsSubFile = contains(partName);
         if (containsSubFile && ! stepIgnore) {
-          countInstances(tokens[14],mirrored(tokens),false);
+          f->_subFileRefs.append(SubFileRef(partName,line._mirrored,false));
         }
         partsAdded = true;
       }
     }
     //add step if parts added
-    f->_numSteps += partsAdded && ! noStep &&
-                       ( (isMirrored && f->_mirrorInstances == 0) ||
-                       (!isMirrored && f->_instances == 0) );
-    //
-    if ( ! callout) {
-      if (isMirrored) {
-        ++f->_mirrorInstances;
-      } else {
-        ++f->_instances;
-      }
-    }
+    f->_numSteps += partsAdded && ! noStep;
 
+    f->_subFileRefsChanged = false;
+    _subFileRefsCounted = true;
   } // file end
-  f->_beenCounted = true;
 }
 
+/*
+ * Return the subfile with its step count brought up to date, the
+ * instance counts are still left to countInstances.
+ */
+LDrawSubFile *LDrawFile::countedSubFile(const QString &mcFileName)
+{
+  LDrawSubFile *f = subFile(mcFileName);
+  if (! f)
+    return nullptr;
+
+  if (f->_subFileRefsChanged) {
+    countSubFileRefs(mcFileName.toLower());
+    buildMod = 0;
+  }
+  return f;
+}
+
+/*
+ * Return the build modification level of a line - the number of blocks
+ * open at the line when blocks close on the given command. The innermost
+ * block is the last one begun at or before the line, or the first of its
+ * enclosing blocks not yet closed. Levels are local to the submodel: a
+ * block open around a submodel reference does not raise the levels of the
+ * blocks inside the referenced submodel.
+ */
+int LDrawFile::buildModLevel(LDrawSubFile *f, int lineNumber, int close)
+{
+  if (! f)
+    return 0;
+  if (f->_buildModsChanged)
+    f->indexBuildMods();
+
+  const QVector<BuildModBlock> &blocks = f->_buildModBlocks;
+  int b = int(std::upper_bound(blocks.constBegin(), blocks.constEnd(), lineNumber,
+                               [] (int line, const BuildModBlock &block) {
+                                   return line < block._beginLine;
+                               }) - blocks.constBegin()) - 1;
+  while (b >= 0 && blocks[b]._closeLine[close] <= lineNumber)
+    b = blocks[b]._parent[close];
+  return b >= 0 ? blocks[b]._level[close] : 0;
+}
+
+int LDrawFile::buildModLevel(const Where &here, int close)
+{
+  return buildModLevel(subFile(subFileHandle(here)), here.lineNumber, close);
+}
+
+/*
+ * Submodels are counted once for every reference from a submodel reachable
+ * from the top level model. A called out reference makes a submodel
+ * reachable, and is counted as an instance only when the submodel was
+ * already reached - see countSubFileInstances.
+ */
 void LDrawFile::countInstances()
 {
+  bool refsChanged = _subFileRefsChanged || _subFileRefsCounted;
   for (int i = 0; i < _subFileOrder.size(); i++) {
     QString fileName = _subFileOrder[i].toLower();
     QMap<QString, LDrawSubFile>::iterator it = _subFiles.find(fileName);
-    it->_instances = 0;
-    it->_mirrorInstances = 0;
-    it->_beenCounted = false;
+    if (it != _subFiles.end() && (_subFileRefsChanged || it->_subFileRefsChanged)) {
+      countSubFileRefs(fileName);
+      refsChanged = true;
+    }
   }
+  _subFileRefsChanged = false;
+  _subFileRefsCounted = false;
   buildMod = 0;
-  _currentLevels.clear();
-  countInstances(topLevelFile(),false);
+
+  if (! refsChanged)
+    return;
+
+  for (int i = 0; i < _subFileOrder.size(); i++) {
+    QString fileName = _subFileOrder[i].toLower();
+    QMap<QString, LDrawSubFile>::iterator it = _subFiles.find(fileName);
+    if (it != _subFiles.end()) {
+      it->_instances = 0;
+      it->_mirrorInstances = 0;
+      it->_beenCounted = false;
+    }
+  }
+
+  QMap<QString, LDrawSubFile>::iterator top = _subFiles.find(topLevelFile().toLower());
+  if (top == _subFiles.end())
+    return;
+
+  ++top->_instances;
+  top->_beenCounted = true;
+  countSubFileInstances(top.value());
+}
+
+/*
+ * Count the references of a reached submodel in line order, descending into
+ * each submodel on its first reference. A called out reference to a
+ * submodel not yet reached only makes it reachable, while one to a submodel
+ * already reached counts an instance like any other reference.
+ */
+void LDrawFile::countSubFileInstances(LDrawSubFile &f)
+{
+  foreach (const SubFileRef &ref, f._subFileRefs) {
+    QMap<QString, LDrawSubFile>::iterator it = _subFiles.find(ref._fileName);
+    if (it == _subFiles.end())
+      continue;
+    if (! it->_beenCounted) {
+      it->_beenCounted = true;
+      countSubFileInstances(it.value());
+      if (ref._calledOut)
+        continue;
+    }
+    if (ref._mirrored) {
+      ++it->_mirrorInstances;
+    } else {
+      ++it->_instances;
+    }
+  }
+}
+
+/*
+ * Return the subfiles named by a type 1 line of a submodel reachable from
+ * the top level model. Lines in ignored and build modification blocks are
+ * included as a step may still render them. Valid after countInstances().
+ */
+QSet<QString> LDrawFile::referencedSubFiles()
+{
+  QSet<QString> referenced;
+  QMap<QString, LDrawSubFile>::const_iterator f = _subFiles.constBegin();
+  for (; f != _subFiles.constEnd(); ++f) {
+    if (! f->_beenCounted)
+      continue;
+    for (int i = 0; i < f->_lines.size(); i++) {
+      if (f->_lines[i]._partId != -1)
+        referenced.insert(partName(f->_lines[i]._partId).toLower());
+    }
+  }
+  return referenced;
 }
 
 bool LDrawFile::saveMPDFile(const QString &fileName)
@@ -1626,6 +2519,7 @@ bool LDrawFile::saveMPDFile(const QString &fileName)
             out.setCodec(_currFileIsUTF8 ? QTextCodec::codecForName("UTF-8") : QTextCodec::codecForName("System"));
         }
         out << "0 FILE " << subFileName << endl;
+        f.value().unpack();
         for (int j = 0; j < f.value()._contents.size(); j++) {
           out << f.value()._contents[j] << endl;
         }
@@ -1647,51 +2541,33 @@ void LDrawFile::countParts(const QString &fileName){
     QMap<QString, LDrawSubFile>::iterator f = _subFiles.find(fileName.toLower());
     if (f != _subFiles.end()) {
         // get content size and reset numSteps
-        int j = f->_contents.size();
+        int j = f->_lines.size();
 
         // process submodel content...
         for (int i = 0; i < j; i++) {
-            QStringList tokens;
-            QString line = f->_contents[i];
-
-            split(line,tokens);
+            const LDrawLine &line = f->_lines[i];
 
             bool doCountPart = true;
 
-// interrogate each line
-//          if (tokens[0] != "1") {
-//              logNotice() << QString("     Line: [%1] %2").arg(fileName).arg(line);
-//            }
-
             // build modification - end at action to include original parts
-            if (tokens.size() >= 4 && tokens[0] == "0"  &&
-               (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-                tokens[2] == "BUILD_MOD") {
-                if (tokens[3] == "BEGIN") {
-                    buildMod = getLevel(tokens[4],HiarchLevel::BEGIN);
-                } else if (tokens[3] == "APPLY" || tokens[3] == "REMOVE") {
-                    buildMod = getLevel(QString(),HiarchLevel::END);
-                }
+            if (line._op >= LDrawLine::BuildModBeginOp &&
+                line._op <= LDrawLine::BuildModOtherOp) {
+                buildMod = buildModLevel(&f.value(), i, BuildModBlock::ActionClose);
                 doCountPart = ! buildMod;
             } else
-            if (tokens.size() == 5 && tokens[0] == "0" &&
-               (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-               (tokens[2] == "PART" || tokens[2] == "PLI") &&
-                tokens[3] == "BEGIN"  &&
-                tokens[4] == "IGN") {
+            if (line._op == LDrawLine::PartIgnoreBeginOp) {
                 doCountPart = false;
             } else
-            if (tokens.size() == 4 && tokens[0] == "0" &&
-               (tokens[1] == "LPUB" || tokens[1] == "!LPUB") &&
-               (tokens[2] == "PART" || tokens[2] == "PLI") &&
-                tokens[3] == "END") {
+            if (line._op == LDrawLine::PartIgnoreEndOp) {
                doCountPart = true;
             }
 
             QString partToken;
-            if (doCountPart && tokens.size() == 15 && tokens[0] == "1" && (tokens[14].contains(validExtRx))) {
-                partToken = tokens[14];
-            } else if ((doCountPart = isSubstitute(line,partToken))) {
+            if (doCountPart && line._partId != -1 && (LDrawFile::partName(line._partId).contains(validExtRx))) {
+                partToken = LDrawFile::partName(line._partId);
+            } else if ((doCountPart = line._op == LDrawLine::SubstituteOp)) {
+                QString substitute = f->_packed ? f->packedLine(i) : f->_contents[i];
+                isSubstitute(substitute,partToken);
                 doCountPart = !partToken.isEmpty() && partToken.contains(validExtRx);
             }
             if (doCountPart) {
@@ -1809,6 +2685,7 @@ bool LDrawFile::saveLDRFile(const QString &fileName)
           }
           QTextStream out(&file);
           out.setCodec(_currFileIsUTF8 ? QTextCodec::codecForName("UTF-8") : QTextCodec::codecForName("System"));
+          f.value().unpack();
           for (int j = 0; j < f.value()._contents.size(); j++) {
             out << f.value()._contents[j] << endl;
           }
@@ -1832,6 +2709,19 @@ bool LDrawFile::changedSinceLastWrite(const QString &fileName)
   return false;
 }
 
+/*
+ * Embedded unofficial parts are written to the temp directory but never
+ * laid out, release their line lists once they are written.
+ */
+void LDrawFile::packSubFiles()
+{
+  QMap<QString, LDrawSubFile>::iterator f = _subFiles.begin();
+  for (; f != _subFiles.end(); ++f) {
+    if (f->_unofficialPart != UNOFFICIAL_SUBMODEL && ! f->_generated && ! f->_changedSinceLastWrite)
+      f->pack();
+  }
+}
+
 void LDrawFile::tempCacheCleared()
 {
   QString key;
@@ -1923,9 +2813,9 @@ int LDrawFile::getBuildModAction(const QString &buildModKey, int stepNumber)
   QString modKey = buildModKey.toLower();
   QMap<QString, BuildMod>::iterator i = _buildMods.find(modKey);
   if (i != _buildMods.end()) {
-    QMap<int, int>::iterator a = i.value()._modActions.find(stepNumber);
+    QHash<int, int>::iterator a = i.value()._modActions.find(stepNumber);
     if (a != i.value()._modActions.end())
-        return i.value()._modActions.value(stepNumber);
+        return a.value();
   }
   return 0 /*OkRc*/;
 }
@@ -1939,7 +2829,7 @@ void LDrawFile::setBuildModAction(
     QMap<QString, BuildMod>::iterator i = _buildMods.find(modKey);
 
     if (i != _buildMods.end()) {
-        QMap<int, int>::iterator a = i.value()._modActions.find(stepNumber);
+        QHash<int, int>::iterator a = i.value()._modActions.find(stepNumber);
         if (a != i.value()._modActions.end())
             i.value()._modActions.remove(stepNumber);
         i.value()._modActions.insert(stepNumber, modAction);
@@ -1995,6 +2885,145 @@ bool LDrawFile::buildModContains(const QString &buildModKey)
   return false;
 }
 
+/*
+ * Viewer step contents are cumulative, so each step is stored as a delta
+ * against the step inserted before it in the same submodel: the lines the
+ * base does not share at its head and tail. The kept lines are implicitly
+ * shared QStrings. Every VIEWER_STEP_MAX_DEPTH deltas a step is stored
+ * whole, and the last few rebuilt steps are cached.
+ */
+
+#define VIEWER_STEP_MAX_DEPTH  16
+#define VIEWER_STEP_CACHE_SIZE 8
+
+/* viewer step keys are <model index|part>;<line number|colour>;<step number>[suffix],
+ * steps of a group differ only by line and step number */
+
+static QString viewerStepGroup(const QString &mStepKey)
+{
+  QString stepNumber = mStepKey.section(';',2);
+  int i = 0;
+  while (i < stepNumber.size() && stepNumber.at(i).isDigit())
+    i++;
+  return mStepKey.section(';',0,0) + ";" + stepNumber.mid(i);
+}
+
+QStringList LDrawFile::viewerStepContents(const QString &mStepKey, bool rotated, bool cache)
+{
+  QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
+  if (i == _viewerSteps.end())
+    return _emptyList;
+
+  const ViewerStepContents &stepContents = rotated ? i.value()._rotatedContents : i.value()._unrotatedContents;
+  if (stepContents._baseKey.isEmpty())
+    return stepContents._lines;
+
+  QString cacheKey = mStepKey + (rotated ? ";r" : ";u");
+  for (int n = 0; n < _viewerStepCache.size(); n++) {
+    if (_viewerStepCache[n].first == cacheKey) {
+      if (n)
+        _viewerStepCache.move(n, 0);
+      return _viewerStepCache.first().second;
+    }
+  }
+
+  QStringList base = viewerStepContents(stepContents._baseKey, rotated, false);
+  QStringList contents = base.mid(0, stepContents._head);
+  contents << stepContents._lines;
+  contents << base.mid(base.size() - stepContents._tail);
+
+  if (cache) {
+    _viewerStepCache.prepend(qMakePair(cacheKey, contents));
+    if (_viewerStepCache.size() > VIEWER_STEP_CACHE_SIZE)
+      _viewerStepCache.removeLast();
+  }
+  return contents;
+}
+
+void LDrawFile::encodeViewerStepContents(const QString     &mStepKey,
+                                         bool               rotated,
+                                         const QString     &baseKey,
+                                         const QStringList &contents)
+{
+  QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
+  if (i == _viewerSteps.end())
+    return;
+
+  ViewerStepContents stepContents;
+  stepContents._lines = contents;
+
+  QMap<QString, ViewerStep>::iterator b = _viewerSteps.find(baseKey);
+  if (b != _viewerSteps.end() && baseKey != mStepKey) {
+    int depth = (rotated ? b.value()._rotatedContents : b.value()._unrotatedContents)._depth;
+    if (depth < VIEWER_STEP_MAX_DEPTH) {
+      QStringList base = viewerStepContents(baseKey, rotated);
+      const int size = qMin(base.size(), contents.size());
+      int head = 0, tail = 0;
+      while (head < size && base.at(head) == contents.at(head))
+        head++;
+      while (tail < size - head &&
+             base.at(base.size() - 1 - tail) == contents.at(contents.size() - 1 - tail))
+        tail++;
+      if (head + tail) {
+        stepContents._baseKey = baseKey;
+        stepContents._head    = head;
+        stepContents._tail    = tail;
+        stepContents._depth   = depth + 1;
+        stepContents._lines   = contents.mid(head, contents.size() - head - tail);
+      }
+    }
+  }
+
+  if (rotated)
+    i.value()._rotatedContents = stepContents;
+  else
+    i.value()._unrotatedContents = stepContents;
+}
+
+/* Replace the contents of a step - when rebase is set the steps built on
+ * it keep their contents and are encoded against the new contents */
+
+void LDrawFile::setViewerStepContents(const QString     &mStepKey,
+                                      bool               rotated,
+                                      const QString     &baseKey,
+                                      const QStringList &contents,
+                                      bool               rebase)
+{
+  QList<QPair<QString, QStringList> > dependents;
+  QMap<QString, ViewerStep>::iterator i = _viewerSteps.begin();
+  for (; rebase && i != _viewerSteps.end(); ++i) {
+    const ViewerStepContents &stepContents = rotated ? i.value()._rotatedContents : i.value()._unrotatedContents;
+    if (stepContents._baseKey == mStepKey)
+      dependents << qMakePair(i.key(), viewerStepContents(i.key(), rotated, false));
+  }
+
+  // a base that is built on this step would close a loop
+  QString safeBaseKey = baseKey;
+  for (QString key = baseKey; ! key.isEmpty(); ) {
+    if (key == mStepKey) {
+      safeBaseKey.clear();
+      break;
+    }
+    i = _viewerSteps.find(key);
+    if (i == _viewerSteps.end())
+      break;
+    key = (rotated ? i.value()._rotatedContents : i.value()._unrotatedContents)._baseKey;
+  }
+
+  encodeViewerStepContents(mStepKey, rotated, safeBaseKey, contents);
+
+  QString cacheKey = mStepKey + (rotated ? ";r" : ";u");
+  for (int n = 0; n < _viewerStepCache.size(); n++) {
+    if (_viewerStepCache[n].first == cacheKey) {
+      _viewerStepCache.removeAt(n);
+      break;
+    }
+  }
+
+  for (const QPair<QString, QStringList> &dependent : dependents)
+    encodeViewerStepContents(dependent.first, rotated, mStepKey, dependent.second);
+}
+
 /* Add a new Viewer Step */
 
 void LDrawFile::insertViewerStep(const QString     &stepKey,
@@ -2006,13 +3035,27 @@ void LDrawFile::insertViewerStep(const QString     &stepKey,
                                  bool               calledOut)
 {
   QString    mStepKey = stepKey.toLower();
+  QString    group    = viewerStepGroup(mStepKey);
+  QString    baseKey  = _viewerStepLast.value(group);
   QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
-
-  if (i != _viewerSteps.end()) {
-    _viewerSteps.erase(i);
+  bool       redrawn  = i != _viewerSteps.end();
+
+  if (redrawn) {
+    // a redrawn step keeps its contents while the new ones are encoded
+    if (baseKey == mStepKey)
+      baseKey = i.value()._rotatedContents._baseKey;
+    ViewerStepContents rotatedStepContents   = i.value()._rotatedContents;
+    ViewerStepContents unrotatedStepContents = i.value()._unrotatedContents;
+    i.value() = ViewerStep(filePath,csiKey,multiStep,calledOut);
+    i.value()._rotatedContents   = rotatedStepContents;
+    i.value()._unrotatedContents = unrotatedStepContents;
+  } else {
+    ViewerStep viewerStep(filePath,csiKey,multiStep,calledOut);
+    _viewerSteps.insert(mStepKey,viewerStep);
   }
-  ViewerStep viewerStep(rotatedContents,unrotatedContents,filePath,csiKey,multiStep,calledOut);
-  _viewerSteps.insert(mStepKey,viewerStep);
+  setViewerStepContents(mStepKey, true, baseKey, rotatedContents, redrawn);
+  setViewerStepContents(mStepKey, false, baseKey, unrotatedContents, redrawn);
+  _viewerStepLast.insert(group, mStepKey);
 }
 
 /* Viewer Step Exist */
@@ -2023,11 +3066,9 @@ void LDrawFile::updateViewerStep(const QString &stepKey, const QStringList &cont
   QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
 
   if (i != _viewerSteps.end()) {
-    if (rotated)
-      i.value()._rotatedContents = contents;
-    else
-      i.value()._unrotatedContents = contents;
+    QString baseKey = (rotated ? i.value()._rotatedContents : i.value()._unrotatedContents)._baseKey;
     i.value()._modified = true;
+    setViewerStepContents(mStepKey, rotated, baseKey, contents);
   }
 }
 
@@ -2035,24 +3076,14 @@ void LDrawFile::updateViewerStep(const QString &stepKey, const QStringList &cont
 
 QStringList LDrawFile::getViewerStepRotatedContents(const QString &stepKey)
 {
-  QString mStepKey = stepKey.toLower();
-  QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
-  if (i != _viewerSteps.end()) {
-    return i.value()._rotatedContents;
-  }
-  return _emptyList;
+  return viewerStepContents(stepKey.toLower(), true);
 }
 
 /* return viewer step unrotatedContents */
 
 QStringList LDrawFile::getViewerStepUnrotatedContents(const QString &stepKey)
 {
-  QString mStepKey = stepKey.toLower();
-  QMap<QString, ViewerStep>::iterator i = _viewerSteps.find(mStepKey);
-  if (i != _viewerSteps.end()) {
-    return i.value()._unrotatedContents;
-  }
-  return _emptyList;
+  return viewerStepContents(stepKey.toLower(), false);
 }
 
 /* return viewer step file path */
@@ -2123,6 +3154,8 @@ bool LDrawFile::isViewerStepCalledOut(const QString &stepKey)
 void LDrawFile::clearViewerSteps()
 {
   _viewerSteps.clear();
+  _viewerStepLast.clear();
+  _viewerStepCache.clear();
 }
 
 // -- -- Utility Functions -- -- //
@@ -2257,6 +3290,9 @@ QList<QRegExp> LDrawUnofficialOtherRegExp;
 LDrawFile::LDrawFile()
 {
     _loadedParts.clear();
+    _subFileRefsChanged = true;
+    _subFileRefsCounted = false;
+    _tokenizeDeferred = false;
   {
     LDrawHeaderRegExp
         << QRegExp("^0\\s+AUTHOR:?[^\n]*",Qt::CaseInsensitive)
@@ -2346,6 +3382,10 @@ bool isComment(QString &line){
 }
 
 bool isSubstitute(QString &line, QString &lineOut){
+  if (! line.contains("SUB",Qt::CaseInsensitive)) {
+      lineOut = QString();
+      return false;
+  }
   QRegExp substitutePart("BEGIN\\sSUB\\s([A-Za-z0-9\\s_-]+.[dat|mpd|ldr]+)",Qt::CaseInsensitive);
   if (line.contains(substitutePart)) {
       lineOut = substitutePart.cap(1);
@@ -2357,6 +3397,8 @@ bool isSubstitute(QString &line, QString &lineOut){
 
 int getUnofficialFileType(QString &line)
 {
+  if (! line.contains("UNOFFICIAL",Qt::CaseInsensitive))
+    return UNOFFICIAL_SUBMODEL;
   int size = LDrawUnofficialPartRegExp.size();
   for (int i = 0; i < size; i++) {
     if (line.contains(LDrawUnofficialPartRegExp[i])) {
@@ -33,21 +33,115 @@
 #include <QStringList>
 #include <QString>
 #include <QMap>
+#include <QHash>
 #include <QDateTime>
 #include <QList>
+#include <QVector>
+#include <QSet>
+#include <QMutex>
 
 #include "excludedparts.h"
 #include "QsLog.h"
 
+class Where;
+
 extern QList<QRegExp> LDrawHeaderRegExp;
 extern QList<QRegExp> LDrawUnofficialPartRegExp;
 extern QList<QRegExp> LDrawUnofficialSubPartRegExp;
 extern QList<QRegExp> LDrawUnofficialPrimitiveRegExp;
 extern QList<QRegExp> LDrawUnofficialOtherRegExp;
 
+/********************************************
+ * pre-tokenized line
+ ********************************************/
+
+class LDrawLine {
+  public:
+    enum LineOp {
+      OtherOp = 0,         // not a pre-classified meta command
+      StepOp,              // 0 STEP or 0 ROTSTEP
+      NoStepOp,            // 0 !LPUB NOSTEP
+      CalloutBeginOp,      // 0 !LPUB CALLOUT BEGIN
+      CalloutEndOp,        // 0 !LPUB CALLOUT END
+      BuildModBeginOp,     // 0 !LPUB BUILD_MOD BEGIN <key>
+      BuildModActionOp,    // 0 !LPUB BUILD_MOD APPLY|REMOVE
+      BuildModEndModOp,    // 0 !LPUB BUILD_MOD END_MOD
+      BuildModEndOp,       // 0 !LPUB BUILD_MOD END
+      BuildModOtherOp,     // 0 !LPUB BUILD_MOD <other>
+      PartIgnoreBeginOp,   // 0 !LPUB PART|PLI BEGIN IGN
+      PartIgnoreEndOp,     // 0 !LPUB PART|PLI END
+      SubstituteOp,        // 0 !LPUB PLI BEGIN SUB <part>
+      BufExchgOp           // 0 BUFEXCHG <buffer> STORE|RETRIEVE
+    };
+    int          _type;         // LDraw line type, -1 if blank
+    int          _op;           // LineOp
+    int          _colour;       // line types 1 to 5
+    float        _matrix[12];   // line type 1: x y z a b c d e f g h i
+    int          _partId;       // line type 1: interned part name, -1 if not a valid part line
+    bool         _mirrored;     // line type 1: negative transform determinant
+    QString      _buildModKey;  // BUILD_MOD BEGIN key
+    bool         _metaCompiled; // _metaArgv is set
+    QStringList  _metaArgv;     // Meta::parse tokens, built on first parse
+
+    LDrawLine()
+    {
+      _type = -1;
+      _op = OtherOp;
+      _colour = 0;
+      _partId = -1;
+      _mirrored = false;
+      _metaCompiled = false;
+    }
+    LDrawLine(const QString &line);
+};
+
+/********************************************
+ * build modification block - a BUILD_MOD BEGIN
+ * and the line closing it for each of the ways
+ * the nesting of build mods is tracked
+ ********************************************/
+
+class BuildModBlock {
+  public:
+    enum Close {
+      ActionClose,             // APPLY|REMOVE - subfile part and step counts
+      EndModClose,             // END_MOD - BOM parts
+      EndClose,                // END - page traversal and temp files
+      NumClose
+    };
+    QString      _key;                  // lower case BUILD_MOD BEGIN key
+    int          _beginLine;
+    int          _closeLine[NumClose];  // INT_MAX while open to the end of the subfile
+    int          _parent[NumClose];     // block open when this one began, -1 at top level
+    int          _level[NumClose];      // nesting level of the lines inside this block
+};
+
+class SubFileRef {
+  public:
+    QString      _fileName;
+    bool         _mirrored;
+    bool         _calledOut;
+
+    SubFileRef()
+    {
+      _mirrored = false;
+      _calledOut = false;
+    }
+    SubFileRef(const QString &fileName, bool mirrored, bool calledOut)
+    {
+      _fileName = fileName;
+      _mirrored = mirrored;
+      _calledOut = calledOut;
+    }
+};
+
 class LDrawSubFile {
   public:
     QStringList  _contents;
+    QVector<LDrawLine> _lines;  // _contents pre-tokenized, kept in sync on edit
+    bool         _packed;         // _contents released to _packedContents
+    QByteArray   _packedContents; // UTF-8 lines, each ended by a newline
+    QVector<int> _packedOffsets;  // start of each line in _packedContents
     QString      _subFilePath;
     bool         _modified;
     QDateTime    _datetime;
@@ -55,9 +149,13 @@ class LDrawSubFile {
     QStringList  _mirrorRenderedKeys;
     QVector<int> _lineTypeIndexes;
     int          _numSteps;
+    QVector<BuildModBlock> _buildModBlocks; // in begin line order
+    bool         _buildModsChanged;       // lines edited since _buildModBlocks was built
     bool         _beenCounted;
     int          _instances;
     int          _mirrorInstances;
+    QVector<SubFileRef> _subFileRefs;  // submodel references in line order
+    bool         _subFileRefsChanged;
     bool         _rendered;
     bool         _mirrorRendered;
     bool         _changedSinceLastWrite;
@@ -69,6 +167,10 @@ class LDrawSubFile {
     LDrawSubFile()
     {
       _unofficialPart = 0;
+      _packed = false;
+      _beenCounted = false;
+      _subFileRefsChanged = true;
+      _buildModsChanged = true;
     }
     LDrawSubFile(
             const QStringList &contents,
@@ -76,16 +178,43 @@ class LDrawSubFile {
             int                unofficialPart,
             bool               generated = false,
             const QString     &subFilePath = QString());
+    void tokenize();
+    void indexBuildMods();
+    void pack();
+    void unpack();
+    QString packedLine(int lineNumber) const;
     ~LDrawSubFile()
     {
       _contents.clear();
     }
 };
 
+/********************************************
+ * viewer step contents - the lines between the
+ * first _head and the last _tail lines of the
+ * base step, or all lines when there is no base
+ ********************************************/
+
+class ViewerStepContents {
+  public:
+    QString     _baseKey;
+    int         _head;
+    int         _tail;
+    int         _depth;    // deltas down to a step stored whole
+    QStringList _lines;
+
+    ViewerStepContents()
+    {
+      _head  = 0;
+      _tail  = 0;
+      _depth = 0;
+    }
+};
+
 class ViewerStep {
   public:
-    QStringList _rotatedContents;
-    QStringList _unrotatedContents;
+    ViewerStepContents _rotatedContents;
+    ViewerStepContents _unrotatedContents;
     QString   	_filePath;
     QString     _csiKey;
     bool        _modified;
@@ -97,46 +226,32 @@ class ViewerStep {
       _modified = false;
     }
     ViewerStep(
-      const QStringList &rotatedContents,
-      const QStringList &unrotatedContents,
       const QString     &filePath,
       const QString     &csiKey,
       bool               multiStep,
       bool               calledOut);
-    ~ViewerStep()
-    {
-      _rotatedContents.clear();
-      _unrotatedContents.clear();
-    }
 };
 
 /********************************************
- * this is a utility class that enables nested
- * levels
+ * rendered state of a subfile, captured with
+ * page checkpoints so a resumed traversal sees
+ * the same submodels as already rendered
  ********************************************/
 
-class HiarchLevel
-{
-public:
-    enum { BEGIN, END };
-    HiarchLevel(const QString &key)
-        : level(nullptr),
-          key(key)
-    {
-    }
-    ~HiarchLevel()
-    {
-    }
-    HiarchLevel* GetTopLevel()
+class RenderedState {
+  public:
+    QStringList _renderedKeys;
+    QStringList _mirrorRenderedKeys;
+    bool        _rendered;
+    bool        _mirrorRendered;
+
+    RenderedState()
     {
-        return level ? level->GetTopLevel() : this;
+      _rendered       = false;
+      _mirrorRendered = false;
     }
-    HiarchLevel* level;
-    QString key;
 };
 
-extern int getLevel(const QString& key, int rc);
-
 /********************************************
  * build modification
  ********************************************/
@@ -144,7 +259,7 @@ extern int getLevel(const QString& key, int rc);
 class BuildMod {
   public:
     QVector<int>  _modAttributes;
-    QMap<int,int> _modActions;
+    QHash<int,int> _modActions;
     int           _stepNumber;
 
     BuildMod()
@@ -165,12 +280,23 @@ class BuildMod {
 class LDrawFile {
   private:
     QMap<QString, LDrawSubFile> _subFiles;
+    QVector<LDrawSubFile *>     _subFileHandles;     // handle -> subfile in _subFiles, nullptr once emptied
+    QHash<QString, int>         _subFileHandleIds;   // case folded name -> handle
+    QHash<QString, int>         _subFileHandleNames; // name as passed by callers -> handle
+    const LDrawSubFile         *_subFileHandlesBase; // first _subFiles node the handles were taken from
     QMap<QString, ViewerStep>   _viewerSteps;
+    QHash<QString, QString>     _viewerStepLast;  // viewer step group -> last inserted step key
+    QList<QPair<QString, QStringList> > _viewerStepCache; // recently rebuilt step contents, most recent first
     QMap<QString, BuildMod>     _buildMods;
     QMultiHash<QString, int>    _ldcadGroups;
     QStringList                 _emptyList;
     QString                     _emptyString;
     bool                        _mpd;
+    bool                        _subFileRefsChanged;
+    bool                        _subFileRefsCounted;
+    bool                        _tokenizeDeferred; // loadMPDFile tokenizes inserted subfiles at the end
+    bool                        _loadUnresolved;   // a referenced subfile was not found while loading
+    QStringList                 _loadStagedFiles;  // files read to resolve subfiles while loading
     static int                  _emptyInt;
 
     ExcludedParts               excludedParts; // internal list of part count excluded parts
@@ -198,8 +324,6 @@ class LDrawFile {
 
     QStringList                 _subFileOrder;
     QStringList                 _buildModList;
-    static QList<HiarchLevel*>  _currentLevels;
-    static QList<HiarchLevel*>  _allLevels;
     static QStringList          _loadedParts;
     static QString              _file;
     static QString              _name;
@@ -210,17 +334,32 @@ class LDrawFile {
     static int                  _partCount;
     static bool                 _showLoadMessages;
     static bool                 _loadAborted;
+    static QStringList          _partNames;    // interned line type 1 part names
+    static QHash<QString, int>  _partIds;
+    static QMutex               _partIdsMutex;
+    static QHash<QString, QString> _subFileIndex; // lower case file name -> path over the search dirs
+    static QStringList          _subFileIndexDirs;
+    static bool                 _subFileIndexed;
+    static QMutex               _subFileIndexMutex;
 
     int getPartCount(){
       return _partCount;
     }
 
     static void showLoadMessages();
+    static int partId(const QString &name);
+    static QString partName(int partId);
+    static QStringList subFileSearchDirs();
+    static QString findSubFile(const QString &fileName);
+    static void clearSubFileIndex();
 
     bool saveFile(const QString &fileName);
     bool saveMPDFile(const QString &filename);
     bool saveLDRFile(const QString &filename);
 
+    bool readLoadSnapshot(const QString &snapshotFile, const QDateTime &datetime);
+    void writeLoadSnapshot(const QString &snapshotFile);
+    void tokenizeSubFiles();
     void insert(const QString       &fileName,
                       QStringList   &contents,
                       QDateTime     &datetime,
@@ -229,8 +368,18 @@ class LDrawFile {
                       const QString &subFilePath = QString());
 
     int  size(const QString &fileName);
+    int  size(const Where &here);
     void empty();
 
+    // not thread safe, lookups update the handle caches - see subFile()
+    int subFileHandle(const QString &fileName);
+    int subFileHandle(const Where &here);
+    LDrawSubFile *subFile(int handle);
+    LDrawSubFile *subFile(const QString &fileName)
+    {
+      return subFile(subFileHandle(fileName));
+    }
+
     QStringList getSubFilePaths();
     QStringList contents(const QString &fileName);
     void setSubFilePath(const QString &mcFileName,
@@ -251,6 +400,9 @@ class LDrawFile {
     QStringList subFileOrder();
     
     QString readLine(const QString &fileName, int lineNumber);
+    QString readLine(const Where &here);
+    bool getMetaArgv(const Where &here, const QString &line, QStringList &argv);
+    void setMetaArgv(const Where &here, const QString &line, const QStringList &argv);
     void insertLine( const QString &fileName, int lineNumber, const QString &line);
     void replaceLine(const QString &fileName, int lineNumber, const QString &line);
     void deleteLine( const QString &fileName, int lineNumber);
@@ -287,13 +439,22 @@ class LDrawFile {
             const QString &renderParentModel,
             int            renderStepNumber,
             int            howCounted);
+    QHash<QString, RenderedState> getRenderedState();
+    void setRenderedState(const QHash<QString, RenderedState> &renderedState);
     void addCustomColorParts(const QString &mcFileName, bool autoAdd = false);
     int instances(const QString &fileName, bool mirrored);
     void countParts(const QString &fileName);
     void countInstances();
-    void countInstances(const QString &fileName, bool mirrored, const bool callout = false);
+    QSet<QString> referencedSubFiles();
+    void countSubFileRefs(const QString &fileName);
+    void countSubFileInstances(LDrawSubFile &f);
+    LDrawSubFile *countedSubFile(const QString &fileName);
+    int buildModLevel(LDrawSubFile *f, int lineNumber, int close);
+    int buildModLevel(const Where &here, int close);
+    void resolveSubFileHandles();
     bool changedSinceLastWrite(const QString &fileName);
     void tempCacheCleared();
+    void packSubFiles();
 
     void insertLDCadGroup(const QString &name, int lid);
     bool ldcadGroupMatch(const QString &name, const QStringList &lids);
@@ -336,6 +497,16 @@ class LDrawFile {
     bool        isViewerStepCalledOut(const QString &fileName);
     bool        viewerStepContentExist(const QString &fileName);
     void        clearViewerSteps();
+    QStringList viewerStepContents(const QString &mStepKey, bool rotated, bool cache = true);
+    void        encodeViewerStepContents(const QString     &mStepKey,
+                                         bool               rotated,
+                                         const QString     &baseKey,
+                                         const QStringList &contents);
+    void        setViewerStepContents(const QString     &mStepKey,
+                                      bool               rotated,
+                                      const QString     &baseKey,
+                                      const QStringList &contents,
+                                      bool               rebase = true);
 
     QString     getSubmodelName(int index);
     int         getSubmodelIndex(const QString &fileName);
@@ -1855,6 +1855,9 @@ void Gui::clearTempCache()
       }
 
     ldrawFile.tempCacheCleared();
+    tmpFileHashes.clear();
+    tmpManifest.clear();
+    staleTmpVariants.clear();
 
     emit messageSig(LOG_INFO_STATUS,QString("Temporary model file cache cleaned. %1 items removed.").arg(count1));
 }
@@ -2758,6 +2761,10 @@ Gui::Gui()
 
     displayPageNum = 1;
 
+    pageCheckpointsComplete         = false;
+    pageCheckpointsMaxPages         = 0;
+    recordPageCheckpoints           = false;
+
     processOption                   = EXPORT_ALL_PAGES;
     exportMode                      = EXPORT_PDF;
     pageRangeText                   = "1";
@@ -2935,6 +2942,7 @@ Gui::Gui()
 
 Gui::~Gui()
 {
+  clearPageCheckpoints();
   delete KpageScene;
   delete KpageView;
   delete editWindow;
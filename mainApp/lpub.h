@@ -489,6 +489,66 @@ const QString nativeExportNames[] =
   "BLENDER RENDER" // 16 BLENDER_RENDER
 };
 
+/*
+ * Page checkpoint - the findPage traversal state captured when
+ * the top level model reaches the top of a page. drawPage resumes
+ * from the nearest checkpoint instead of walking from line 0.
+ */
+class PageCheckpoint
+{
+public:
+  Where        current;               // top of page in the top level model
+  Where        saveCurrent;
+  Where        topOfStep;
+  Where        stepGroupCurrent;
+  Meta         meta;
+  Meta         saveMeta;
+  RotStepMeta  saveRotStep;
+  PgSizeData   pageSize;
+  PgSizeData   defaultPageSize;
+
+  QStringList  csiParts;
+  QStringList  saveCsiParts;
+  QVector<int> lineTypeIndexes;
+  QVector<int> saveLineTypeIndexes;
+  QStringList  bfxParts;
+  QStringList  saveBfxParts;
+  QHash<QString, QStringList>  bfx;
+  QHash<QString, QStringList>  saveBfx;
+  QHash<QString, QVector<int>> bfxLineTypeIndexes;
+  QHash<QString, QVector<int>> saveBfxLineTypeIndexes;
+
+  QHash<QString, RenderedState> renderedState;
+  QString      buildModKey;
+  int          buildModAction;
+  bool         buildModIgnore;
+  int          buildMod;
+
+  int          stepNumber;
+  int          saveStepNumber;
+  int          partsAdded;
+  int          countInstances;
+  int          contStepNumber;
+  int          stepPageNum;
+  int          saveStepPageNum;
+  int          saveContStepNum;
+  int          firstStepPageNum;
+  int          lastStepPageNum;
+
+  bool         stepGroup;
+  bool         partIgnore;
+  bool         coverPage;
+  bool         stepPage;
+  bool         bfxStore1;
+  bool         bfxStore2;
+  bool         callout;
+  bool         noStep;
+  bool         noStep2;
+  bool         stepGroupBfxStore2;
+  bool         pageSizeUpdate;
+  bool         enableLineTypeIndexes;
+};
+
 class Gui : public QMainWindow
 {
 
@@ -506,6 +566,10 @@ public:
   int             lastStepPageNum;
   int             savePrevStepPosition; // indicate the previous step position amongst current and previous steps.
   QList<Where>    topOfPages;
+  QMap<int, PageCheckpoint*> pageCheckpoints; // findPage state at the top of each counted page
+  bool            pageCheckpointsComplete;    // checkpoints and page count reflect the whole unedited document
+  int             pageCheckpointsMaxPages;    // page count of the last complete traversal
+  bool            recordPageCheckpoints;      // capture checkpoints during the current traversal
   QList<Where>    parsedMessages;       // previously parsed messages
   QVector<int>    buildModRange;    // begin and end range of modified parts from 3DViewer
 
@@ -540,6 +604,9 @@ public:
   Where &topOfPage();
   Where &bottomOfPage();
 
+  void clearPageCheckpoints();
+  void clearPageCheckpoints(const QString &modelName, int lineNumber);
+
   static int pageSize(PageMeta  &, int which);          // Flip page size per orientation and return size in pixels
 
   void    changePageNum(int offset)
@@ -574,6 +641,10 @@ public:
   {
     return ldrawFile.size(modelName);
   }
+  int subFileSize(const Where &here)
+  {
+    return ldrawFile.size(here);
+  }
   int numSteps(const QString &modelName)
   {
     return ldrawFile.numSteps(modelName);
@@ -582,6 +653,14 @@ public:
     return ldrawFile.getPartCount();
   }
   QString readLine(const Where &here);
+  bool getMetaArgv(const Where &here, const QString &line, QStringList &argv)
+  {
+    return ldrawFile.getMetaArgv(here,line,argv);
+  }
+  void setMetaArgv(const Where &here, const QString &line, const QStringList &argv)
+  {
+    ldrawFile.setMetaArgv(here,line,argv);
+  }
 
   bool isSubmodel(const QString &modelName)
   {
@@ -1081,8 +1160,8 @@ public slots:
   void openDropFile(QString &fileName);
 
   void deployExportBanner(bool b);
-  void setExporting(bool b){ m_exportingContent = b; if (!b){ m_exportingObjects = b; } }
-  void setExportingObjects(bool b){ m_exportingContent = m_exportingObjects = b; }
+  void setExporting(bool b){ if (b && !m_exportingContent){ clearPageCheckpoints(); } m_exportingContent = b; if (!b){ m_exportingObjects = b; } }
+  void setExportingObjects(bool b){ if (b && !m_exportingContent){ clearPageCheckpoints(); } m_exportingContent = m_exportingObjects = b; }
   bool exporting() { return m_exportingContent; }
   bool updateViewer() { return m_updateViewer; }
   bool exportingImages() { return m_exportingContent && !m_exportingObjects; }
@@ -1295,6 +1374,10 @@ private:
   QLabel                *progressLabelPerm;  //
   Step                  *currentStep;        // the current step as loaded in the 3DViewer
 
+  QHash<QString, QByteArray> tmpFileHashes;  // content hash of the files written to the temp directory
+  QString                tmpManifest;        // the manifest tmpFileHashes was read from
+  QSet<QString>          staleTmpVariants;   // fade and highlight copies not written since their submodel changed
+
   PliSubstituteParts     pliSubstituteParts; // internal list of PLI/BOM substitute parts
 
   bool                   m_exportingContent; // indicate export/printing underway
@@ -1339,7 +1422,7 @@ private:
   int findPage(                     // traverse the hierarchy until we get to the
     LGraphicsView   *view,          // page of interest, let traverse process the
     LGraphicsScene  *scene,         // page, and then finish by counting the rest
-    Meta             meta,
+    Meta            &meta,
     QString const   &addLine,
     FindPageOptions &opts
     /*
@@ -1446,12 +1529,20 @@ private:
 
   void writeToTmp();
 
+  QStringList tmpFileContents(
+    const QString &fileName,
+    const QStringList &);
+
+  void readTmpManifest();
+  void writeTmpManifest();
+
   void addCsiTypeLine();
 
   QStringList configureModelSubFile(
     const QStringList &,
     const QString &,
-    const PartType partType);         // fade and or highlight all parts in subfile
+    const PartType partType,
+    const QSet<QString> &submodels);  // fade and or highlight all parts in subfile
 
   QStringList configureModelStep(
     const QStringList &csiParts,
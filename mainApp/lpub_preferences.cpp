@@ -184,6 +184,8 @@ bool    Preferences::usingNativeRenderer        = false;
 bool    Preferences::skipPartsArchive           = false;
 bool    Preferences::loadLastOpenedFile         = false;
 bool    Preferences::extendedSubfileSearch      = false;
+bool    Preferences::mapPartsArchives           = true;
+bool    Preferences::compressMeshCache          = false;
 
 bool    Preferences::pdfPageImage               = false;
 bool    Preferences::ignoreMixedPageSizesMsg    = false;
@@ -269,6 +271,8 @@ int     Preferences::pageDisplayPause           = PAGE_DISPLAY_PAUSE_DEFAULT;
 int     Preferences::cameraDistFactorNative     = CAMERA_DISTANCE_FACTOR_NATIVE_DEFAULT;
 
 int     Preferences::maxOpenWithPrograms        = MAX_OPEN_WITH_PROGRAMS_DEFAULT;
+int     Preferences::exportThreads              = EXPORT_THREADS_DEFAULT;            // 0=all available cores
+int     Preferences::pdfPageLookAhead           = PDF_PAGE_LOOK_AHEAD_DEFAULT;       // measured in pages
 
 // Native POV file generation settings
 QString Preferences::xmlMapPath                 = EMPTY_STRING_DEFAULT;
@@ -3145,6 +3149,16 @@ void Preferences::userInterfacePreferences()
       extendedSubfileSearch = Settings.value(QString("%1/%2").arg(SETTINGS,povrayFileGeneratorKey)).toBool();
   }
 
+  QString const mapPartsArchivesKey("MapPartsArchives");
+  if (Settings.contains(QString("%1/%2").arg(SETTINGS,mapPartsArchivesKey))) {
+      mapPartsArchives = Settings.value(QString("%1/%2").arg(SETTINGS,mapPartsArchivesKey)).toBool();
+  }
+
+  QString const compressMeshCacheKey("CompressMeshCache");
+  if (Settings.contains(QString("%1/%2").arg(SETTINGS,compressMeshCacheKey))) {
+      compressMeshCache = Settings.value(QString("%1/%2").arg(SETTINGS,compressMeshCacheKey)).toBool();
+  }
+
   QString const ldrawFilesLoadMsgsKey("LdrawFilesLoadMsgs");
   if ( ! Settings.contains(QString("%1/%2").arg(SETTINGS,ldrawFilesLoadMsgsKey))) {
       ldrawFilesLoadMsgs = NEVER_SHOW;
@@ -3754,6 +3768,22 @@ void Preferences::exportPreferences()
     } else {
       pdfPageImage = Settings.value(QString("%1/%2").arg(DEFAULTS,"PdfPageImage")).toBool();
     }
+
+    if ( ! Settings.contains(QString("%1/%2").arg(DEFAULTS,"ExportThreads"))) {
+      QVariant uValue(EXPORT_THREADS_DEFAULT);
+      exportThreads = EXPORT_THREADS_DEFAULT;
+      Settings.setValue(QString("%1/%2").arg(DEFAULTS,"ExportThreads"),uValue);
+    } else {
+      exportThreads = Settings.value(QString("%1/%2").arg(DEFAULTS,"ExportThreads")).toInt();
+    }
+
+    if ( ! Settings.contains(QString("%1/%2").arg(DEFAULTS,"PdfPageLookAhead"))) {
+      QVariant uValue(PDF_PAGE_LOOK_AHEAD_DEFAULT);
+      pdfPageLookAhead = PDF_PAGE_LOOK_AHEAD_DEFAULT;
+      Settings.setValue(QString("%1/%2").arg(DEFAULTS,"PdfPageLookAhead"),uValue);
+    } else {
+      pdfPageLookAhead = Settings.value(QString("%1/%2").arg(DEFAULTS,"PdfPageLookAhead")).toInt();
+    }
 }
 
 void Preferences::publishingPreferences()
@@ -231,6 +231,8 @@ class Preferences
     static bool    skipPartsArchive;
     static bool    loadLastOpenedFile;
     static bool    extendedSubfileSearch;
+    static bool    mapPartsArchives;
+    static bool    compressMeshCache;
 
     static bool    enableFadeSteps;
     static bool    fadeStepsUseColour;
@@ -313,6 +315,8 @@ class Preferences
     static int     povrayRenderQuality;
     static int     ldrawFilesLoadMsgs;
     static int     maxOpenWithPrograms;
+    static int     exportThreads;
+    static int     pdfPageLookAhead;
 
     virtual ~Preferences() {}
 };
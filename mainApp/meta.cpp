@@ -50,6 +50,23 @@
 QHash<QString, int> tokenMap;
 QList<QRegExp> groupRegExp;
 
+/* Keyword and value patterns are compiled once on first use and
+ * then shared by every parse. Meta is only parsed on the GUI thread,
+ * the cache is not locked. Entries are never removed and the hash is
+ * never copied, so the returned reference stays valid.
+ */
+
+static const QRegExp &metaRx(const QString &pattern)
+{
+  static QHash<QString, QRegExp> metaRegExp;
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+  QHash<QString, QRegExp>::iterator rx = metaRegExp.find(pattern);
+  if (rx == metaRegExp.end()) {
+      rx = metaRegExp.insert(pattern,QRegExp(pattern));
+    }
+  return rx.value();
+}
+
 bool AbstractMeta::reportErrors = false;
 
 void AbstractMeta::init(
@@ -162,8 +179,8 @@ Rc BranchMeta::parse(QStringList &argv, int index, Where &here)
 
           if (index + offset < size) {
               for (i = list.begin(); i != list.end(); i++) {
-                  QRegExp rx(i.key());
-                  if (argv[index + offset].contains(rx)) {
+                  // indexIn matches on the cached pattern, contains() would copy it
+                  if (metaRx(i.key()).indexIn(argv[index + offset]) != -1) {
 
                       /* Now parse the rest of the argvs */
 
@@ -546,7 +563,7 @@ void StringListMeta::doc(QStringList &out, QString preamble)
 
 Rc BoolMeta::parse(QStringList &argv, int index,Where &here)
 {
-  QRegExp rx("^(TRUE|FALSE)$");
+  const QRegExp &rx = metaRx("^(TRUE|FALSE)$");
   if (index == argv.size() - 1 && argv[index].contains(rx)) {
       _value[pushed] = argv[index] == "TRUE";
       _here[pushed] = here;
@@ -722,42 +739,42 @@ Rc PlacementMeta::parse(QStringList &argv, int index,Where &here)
 
   QString placement, justification, preposition, relativeTo;
 
-  QRegExp rx("^(TOP|BOTTOM)$");
-  if (argv[index].contains(rx)) {
+  const QRegExp *rx = &metaRx("^(TOP|BOTTOM)$");
+  if (argv[index].contains(*rx)) {
       placement = argv[index++];
 
       if (index < argc) {
-          rx.setPattern("^(LEFT|CENTER|RIGHT)$");
-          if (argv[index].contains(rx)) {
+          rx = &metaRx("^(LEFT|CENTER|RIGHT)$");
+          if (argv[index].contains(*rx)) {
               justification = argv[index++];
               rc = OkRc;
             } else {
-              rx.setPattern(relativeTos);
-              if (argv[index].contains(rx)) {
+              rx = &metaRx(relativeTos);
+              if (argv[index].contains(*rx)) {
                   rc = OkRc;
                 }
             }
         }
     } else {
-      rx.setPattern("^(LEFT|RIGHT)$");
-      if (argv[index].contains(rx)) {
+      rx = &metaRx("^(LEFT|RIGHT)$");
+      if (argv[index].contains(*rx)) {
           placement = argv[index++];
 
           if (index < argc) {
-              rx.setPattern("^(TOP|CENTER|BOTTOM)$");
-              if (argv[index].contains(rx)) {
+              rx = &metaRx("^(TOP|CENTER|BOTTOM)$");
+              if (argv[index].contains(*rx)) {
                   justification = argv[index++];
                   rc = OkRc;
                 } else {
-                  rx.setPattern(relativeTos);
-                  if (argv[index].contains(rx)) {
+                  rx = &metaRx(relativeTos);
+                  if (argv[index].contains(*rx)) {
                       rc = OkRc;
                     }
                 }
             }
         } else {
-          rx.setPattern("^(TOP_LEFT|TOP_RIGHT|BOTTOM_LEFT|BOTTOM_RIGHT|CENTER)$");
-          if (argv[index].contains(rx)) {
+          rx = &metaRx("^(TOP_LEFT|TOP_RIGHT|BOTTOM_LEFT|BOTTOM_RIGHT|CENTER)$");
+          if (argv[index].contains(*rx)) {
               placement = argv[index++];
               rc = OkRc;
             } else {
@@ -767,12 +784,12 @@ Rc PlacementMeta::parse(QStringList &argv, int index,Where &here)
     }
 
   if (rc == OkRc && index < argv.size()) {
-      rx.setPattern(relativeTos);
-      if (argv[index].contains(rx)) {
+      rx = &metaRx(relativeTos);
+      if (argv[index].contains(*rx)) {
           relativeTo = argv[index++];
           if (index < argc) {
-              rx.setPattern("^(INSIDE|OUTSIDE)$");
-              if (argv[index].contains(rx)) {
+              rx = &metaRx("^(INSIDE|OUTSIDE)$");
+              if (argv[index].contains(*rx)) {
                   preposition = argv[index++];
                   rc = OkRc;
                 }
@@ -1325,7 +1342,7 @@ QString BorderMeta::text()
 
 Rc PointerAttribMeta::parse(QStringList &argv, int index,Where &here)
 {
-    QRegExp rx("^(POINTER_ATTRIBUTE|DIVIDER_POINTER_ATTRIBUTE)$");
+    const QRegExp &rx = metaRx("^(POINTER_ATTRIBUTE|DIVIDER_POINTER_ATTRIBUTE)$");
     bool isValid = argv[index-1].contains(rx);
 
 //debug - capture line contents
@@ -1494,10 +1511,10 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
 //                    ", argv[1]: " << argv[1] << ", argv[2]: " << argv[2];
 #endif
 
-      QRegExp rx("^(TOP_LEFT|TOP_RIGHT|BOTTOM_LEFT|BOTTOM_RIGHT)$");
+      const QRegExp *rx = &metaRx("^(TOP_LEFT|TOP_RIGHT|BOTTOM_LEFT|BOTTOM_RIGHT)$");
 
       // legacy single-segment pattern - base included
-      if (argv[index].contains(rx) && n_tokens == 4) {
+      if (argv[index].contains(*rx) && n_tokens == 4) {
           _loc = 0;
           bool ok[3];
           _x1   = argv[index+1].toFloat(&ok[0]);
@@ -1506,7 +1523,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail  = ! (ok[0] && ok[1] && ok[2]);
         }
       // legacy single-segment pattern - no base
-      if (argv[index].contains(rx) && n_tokens == 3) {
+      if (argv[index].contains(*rx) && n_tokens == 3) {
           _loc = 0;
           bool ok[2];
           _x1   = argv[index+1].toFloat(&ok[0]);
@@ -1514,7 +1531,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail  = ! (ok[0] && ok[1]);
         }
       // new multi-segment patterns (addl tokens: x2,y2,x3,y3,x4,y4,segments,[baseRect])
-      if (argv[index].contains(rx) && (pagePointer ? n_tokens == 12 : n_tokens == 11)) {
+      if (argv[index].contains(*rx) && (pagePointer ? n_tokens == 12 : n_tokens == 11)) {
           _loc = 0;
           bool ok[10];
           _x1       = argv[index+1].toFloat(&ok[0]);
@@ -1532,7 +1549,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail      = ! (ok[0] && ok[1] && ok[2] && ok[3] && ok[4] &&
                          ok[5] && ok[6] && ok[7] && ok[8] && ok[9]);
         }
-      if (argv[index].contains(rx) && (pagePointer ? n_tokens == 11 : n_tokens == 10)) {
+      if (argv[index].contains(*rx) && (pagePointer ? n_tokens == 11 : n_tokens == 10)) {
           _loc = 0;
           bool ok[9];
           _x1       = argv[index+1].toFloat(&ok[0]);
@@ -1549,8 +1566,8 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail      = ! (ok[0] && ok[1] && ok[2] && ok[3] && ok[4] &&
                          ok[5] && ok[6] && ok[7] && ok[8]);
         }
-      rx.setPattern("^(TOP|BOTTOM|LEFT|RIGHT|CENTER)$");
-      if (argv[index].contains(rx) && n_tokens == 5) {
+      rx = &metaRx("^(TOP|BOTTOM|LEFT|RIGHT|CENTER)$");
+      if (argv[index].contains(*rx) && n_tokens == 5) {
           bool ok[4];
           _loc  = argv[index+1].toFloat(&ok[0]);
           _x1    = argv[index+2].toFloat(&ok[1]);
@@ -1559,7 +1576,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail  = ! (ok[0] && ok[1] && ok[2] && ok[3]);
         }
       // legacy single-segment pattern - no base
-      if (argv[index].contains(rx) && n_tokens == 4) {
+      if (argv[index].contains(*rx) && n_tokens == 4) {
           bool ok[3];
           _loc  = argv[index+1].toFloat(&ok[0]);
           _x1    = argv[index+2].toFloat(&ok[1]);
@@ -1567,7 +1584,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail  = ! (ok[0] && ok[1] && ok[2]);
         }
       // new multi-segment pattern (addl tokens: x2,y2,x3,y3,x4,y4,segments,[baseRect])
-      if (argv[index].contains(rx) && (pagePointer ? n_tokens == 13 : n_tokens == 12)) {
+      if (argv[index].contains(*rx) && (pagePointer ? n_tokens == 13 : n_tokens == 12)) {
           bool ok[11];
           _loc      = argv[index+1].toFloat(&ok[0]);
           _x1       = argv[index+2].toFloat(&ok[1]);
@@ -1585,7 +1602,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
           fail      = ! (ok[0] && ok[1] && ok[2] && ok[3] && ok[4] && ok[5] &&
                          ok[6] && ok[7] && ok[8] && ok[9] && ok[10]);
         }
-      if (argv[index].contains(rx) && (pagePointer ? n_tokens == 12 : n_tokens == 11)) {
+      if (argv[index].contains(*rx) && (pagePointer ? n_tokens == 12 : n_tokens == 11)) {
           bool ok[10];
           _loc      = argv[index+1].toFloat(&ok[0]);
           _x1       = argv[index+2].toFloat(&ok[1]);
@@ -1688,7 +1705,7 @@ Rc PointerMeta::parse(QStringList &argv, int index, Where &here)
 
 QString PointerMeta::format(bool local, bool global)
 {
-  QRegExp rx("^\\s*0.*\\s+(PAGE POINTER|PAGE_POINTER)\\s+.*$");
+  const QRegExp &rx = metaRx("^\\s*0.*\\s+(PAGE POINTER|PAGE_POINTER)\\s+.*$");
   bool pagePointer = preamble.contains(rx);
   QString foo;
   switch(_value[pushed].placement) {
@@ -1792,7 +1809,7 @@ Rc CsiAnnotationIconMeta::parse(QStringList &argv, int index,Where &here)
   CsiAnnotationIconData annotationData;
   Rc rc = FailureRc;
   if (argv.size() - index == 1) {
-      QRegExp rx("^(HIDE|HIDDEN)$");
+      const QRegExp &rx = metaRx("^(HIDE|HIDDEN)$");
       if (argv[index].contains(rx)) {
           annotationData.hidden = true;
           rc = OkRc;
@@ -1800,20 +1817,20 @@ Rc CsiAnnotationIconMeta::parse(QStringList &argv, int index,Where &here)
   }
   else
   if (argv.size() - index >= 10) {
-    QRegExp rx("^(TOP_LEFT|TOP|TOP_RIGHT|LEFT|CENTER|RIGHT|BOTTOM_LEFT|BOTTOM|BOTTOM_RIGHT)$");
+    const QRegExp *rx = &metaRx("^(TOP_LEFT|TOP|TOP_RIGHT|LEFT|CENTER|RIGHT|BOTTOM_LEFT|BOTTOM|BOTTOM_RIGHT)$");
     QStringList entries;
-    if (argv[index].contains(rx)) {
+    if (argv[index].contains(*rx)) {
       entries << QString::number(PlacementEnc(tokenMap[argv[index]]));
       rc = OkRc;
     }
     if (argv.size() - index == 11) {
-      if (argv[++index].contains(rx)) {
+      if (argv[++index].contains(*rx)) {
         entries << QString::number(PlacementEnc(tokenMap[argv[index]]));
         rc = OkRc;
       }
     }
-    rx.setPattern("^(INSIDE|OUTSIDE)$");
-    if (argv[++index].contains(rx)) {
+    rx = &metaRx("^(INSIDE|OUTSIDE)$");
+    if (argv[++index].contains(*rx)) {
       entries << QString::number(PrepositionEnc(tokenMap[argv[index]]));
       rc = OkRc;
     }
@@ -1918,10 +1935,10 @@ Rc FreeFormMeta::parse(QStringList &argv, int index,Where &here)
       rc = OkRc;
     } else if (argv.size() - index == 2) {
       _value[pushed].mode = true;
-      QRegExp rx("^(STEP_NUMBER|ASSEM|PLI|ROTATE_ICON)$");
-      if (argv[index].contains(rx)) {
-          rx.setPattern("^(LEFT|RIGHT|TOP|BOTTOM|CENTER)$");
-          if (argv[index+1].contains(rx)) {
+      const QRegExp *rx = &metaRx("^(STEP_NUMBER|ASSEM|PLI|ROTATE_ICON)$");
+      if (argv[index].contains(*rx)) {
+          rx = &metaRx("^(LEFT|RIGHT|TOP|BOTTOM|CENTER)$");
+          if (argv[index+1].contains(*rx)) {
               _value[pushed].base = PlacementEnc(tokenMap[argv[index]]);
               _value[pushed].justification = PlacementEnc(tokenMap[argv[index+1]]);
               rc = OkRc;
@@ -1960,11 +1977,11 @@ Rc ConstrainMeta::parse(QStringList &argv, int index,Where &here)
 {
   Rc rc = FailureRc;
   bool ok;
-  QRegExp rx;
+  const QRegExp *rx;
   switch(argv.size() - index) {
     case 1:
-      rx.setPattern("^(AREA|SQUARE)$");
-      if (argv[index].contains(rx)) {
+      rx = &metaRx("^(AREA|SQUARE)$");
+      if (argv[index].contains(*rx)) {
           _value[pushed].type = ConstrainData::PliConstrain(tokenMap[argv[index]]);
           rc = OkRc;
         }
@@ -1972,8 +1989,8 @@ Rc ConstrainMeta::parse(QStringList &argv, int index,Where &here)
     case 2:
       argv[index+1].toFloat(&ok);
       if (ok) {
-          rx.setPattern("^(WIDTH|HEIGHT|COLS)$");
-          if (argv[index].contains(rx)) {
+          rx = &metaRx("^(WIDTH|HEIGHT|COLS)$");
+          if (argv[index].contains(*rx)) {
               _value[pushed].type = ConstrainData::PliConstrain(tokenMap[argv[index]]);
               _value[pushed].constraint = argv[index+1].toFloat(&ok);
               rc = OkRc;
@@ -2023,7 +2040,7 @@ AllocMeta::AllocMeta() : LeafMeta()
 
 Rc AllocMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(HORIZONTAL|VERTICAL)$");
+  const QRegExp &rx = metaRx("^(HORIZONTAL|VERTICAL)$");
   if (argv.size() - index == 1 && argv[index].contains(rx)) {
       type[pushed] = AllocEnc(tokenMap[argv[index]]);
       _here[pushed] = here;
@@ -2058,7 +2075,7 @@ FillMeta::FillMeta() : LeafMeta()
 
 Rc FillMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(ASPECT|STRETCH|TILE)$");
+  const QRegExp &rx = metaRx("^(ASPECT|STRETCH|TILE)$");
   if (argv.size() - index == 1 && argv[index].contains(rx)) {
       type[pushed] = FillEnc(tokenMap[argv[index]]);
       _here[pushed] = here;
@@ -2096,7 +2113,7 @@ JustifyStepMeta::JustifyStepMeta() : LeafMeta()
 }
 Rc JustifyStepMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(JUSTIFY_LEFT|JUSTIFY_CENTER|JUSTIFY_CENTER_HORIZONTAL|JUSTIFY_CENTER_VERTICAL)$");
+  const QRegExp &rx = metaRx("^(JUSTIFY_LEFT|JUSTIFY_CENTER|JUSTIFY_CENTER_HORIZONTAL|JUSTIFY_CENTER_VERTICAL)$");
   if (argv[index].contains(rx)) {
       if (argv.size() - index >= 1)
           _value[pushed].type = JustifyStepEnc(tokenMap[argv[index]]);
@@ -2147,7 +2164,7 @@ PageOrientationMeta::PageOrientationMeta() : LeafMeta()
 }
 Rc PageOrientationMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(PORTRAIT|LANDSCAPE)$");
+  const QRegExp &rx = metaRx("^(PORTRAIT|LANDSCAPE)$");
   if (argv.size() - index == 1 && argv[index].contains(rx)) {
       type[pushed] = OrientationEnc(tokenMap[argv[index]]);
       _here[pushed] = here;
@@ -2188,7 +2205,7 @@ CountInstanceMeta::CountInstanceMeta() : LeafMeta()
 
 Rc CountInstanceMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(AT_TOP|AT_MODEL|AT_STEP|TRUE|FALSE)$");
+  const QRegExp &rx = metaRx("^(AT_TOP|AT_MODEL|AT_STEP|TRUE|FALSE)$");
   if (argv.size() - index == 1 && argv[index].contains(rx)) {
       type[pushed]  = CountInstanceEnc(countInstanceMap[argv[index]]);;
       _here[pushed] = here;
@@ -2239,7 +2256,7 @@ ContStepNumMeta::ContStepNumMeta() : LeafMeta()
 
 Rc ContStepNumMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(TRUE|FALSE)$");
+  const QRegExp &rx = metaRx("^(TRUE|FALSE)$");
   if (argv.size() - index == 1 && argv[index].contains(rx)) {
       type[pushed]  = ContStepNumEnc(contStepNumMap[argv[index]]);;
       _here[pushed] = here;
@@ -2419,7 +2436,7 @@ Rc SepMeta::parse(QStringList &argv, int index,Where &here)
         }
     } else
   if (argv.size() - index == 6) {
-      QRegExp rx("CUSTOM|CUSTOM_LENGTH"); // legacy
+      const QRegExp &rx = metaRx("CUSTOM|CUSTOM_LENGTH"); // legacy
       if (argv[index].contains(rx)) {
           argv[index+1].toFloat(&good);
           argv[index+2].toFloat(&ok);
@@ -2532,7 +2549,7 @@ void SepMeta::doc(QStringList &out, QString preamble)
 
 Rc SceneObjectMeta::parse(QStringList &argv, int index, Where &here)
 {
-  QRegExp rx("^(BRING_TO_FRONT|SEND_TO_BACK)$");
+  const QRegExp &rx = metaRx("^(BRING_TO_FRONT|SEND_TO_BACK)$");
   if (argv.size() - index == 3 && argv[index].contains(rx)) {
     bool good, ok;
     float x = argv[index+1].toFloat(&good);
@@ -3416,7 +3433,7 @@ Rc SubMeta::parse(QStringList &argv, int index,Where &here)
     argv[index+8].toFloat(&ok[6]);
     ok[0] &= ok[1] &= ok[2] &=
     ok[3] &= ok[4] &= ok[5] & ok[6];
-    QRegExp rx("^(ABS|REL|ADD)$");
+    const QRegExp &rx = metaRx("^(ABS|REL|ADD)$");
     if (ok[0] && argv[index+9].contains(rx))
       _value.type = rc = PliBeginSub7Rc;       // Rotstep
   } else if (argc == 13) {
@@ -3433,7 +3450,7 @@ Rc SubMeta::parse(QStringList &argv, int index,Where &here)
     ok[0] &= ok[1] &= ok[2] &=
     ok[3] &= ok[4] &= ok[5] &=
     ok[6] &= ok[7] &= ok[8] & ok[9];
-    QRegExp rx("^(ABS|REL|ADD)$");
+    const QRegExp &rx = metaRx("^(ABS|REL|ADD)$");
     if (ok[0] && argv[index+9].contains(rx))
       _value.type = rc = PliBeginSub8Rc;     // target and rotstep
   }
@@ -3566,7 +3583,7 @@ Rc RotStepMeta::parse(QStringList &argv, int index,Where &here)
       argv[index+1].toFloat(&ok[1]);
       argv[index+2].toFloat(&ok[2]);
       ok[0] &= ok[1] & ok[2];
-      QRegExp rx("^(ABS|REL|ADD)$");
+      const QRegExp &rx = metaRx("^(ABS|REL|ADD)$");
       if (ok[0] && argv[index+3].contains(rx)) {
           _value.rots[0] = argv[index+0].toDouble();
           _value.rots[1] = argv[index+1].toDouble();
@@ -5379,6 +5396,11 @@ void Meta::init(BranchMeta * /* unused */, QString /* unused */)
 }
 
 QRegExp Meta::groupRx(QString &line, Rc &rc) {
+    /* every group meta names its CAD tool, skip the patterns otherwise */
+    if ( ! line.contains("CAD",Qt::CaseInsensitive)) {
+        rc = OkRc;
+        return QRegExp();
+    }
     int rxSize = groupRegExp.size();
     for (int i = 0; i < rxSize; i++) {
         if (line.contains(groupRegExp[i])) {
@@ -5402,34 +5424,46 @@ Rc Meta::parse(
 
   AbstractMeta::reportErrors = reportErrors;
 
-  Rc notUsed;
-  QRegExp grpRx = groupRx(line,notUsed);
   QStringList argv;
 
-  if (!grpRx.isEmpty()) {
+  /* Submodel lines keep the tokens of their last parse until the
+   * line is edited, so only the leaf values are decoded again */
 
-      argv << grpRx.cap(1) << grpRx.cap(2) << grpRx.cap(3);
+  if ( ! gui->getMetaArgv(here,line,argv)) {
 
-  } else {
+      Rc notUsed;
+      QRegExp grpRx = groupRx(line,notUsed);
 
-      processSpecialCases(line,here);
+      if (!grpRx.isEmpty()) {
 
-      /* Parse the input line into argv[] */
+          argv << grpRx.cap(1) << grpRx.cap(2) << grpRx.cap(3);
 
-      split(line,argv);
+      } else {
 
-      if (argv.size() > 0) {
-          argv.removeFirst();
-      }
-      if (argv.size()) {
-          if (argv[0] == "LPUB") {
-              argv[0] = "!LPUB";
-          }
+          processSpecialCases(line,here);
+
+          /* Parse the input line into argv[] */
+
+          split(line,argv);
 
-          if (argv[0] == "PLIST") {
-              return  LPub.pli.parse(argv,1,here);
+          if (argv.size() > 0) {
+              argv.removeFirst();
+          }
+          if (argv.size()) {
+              if (argv[0] == "LPUB") {
+                  argv[0] = "!LPUB";
+              }
           }
       }
+
+      /* lines rewritten by processSpecialCases no longer match the
+       * file contents and are left uncached */
+
+      gui->setMetaArgv(here,line,argv);
+  }
+
+  if (argv.size() && argv[0] == "PLIST") {
+      return  LPub.pli.parse(argv,1,here);
   }
 
   if (argv.size() > 0 && list.contains(argv[0])) {
@@ -5489,9 +5523,11 @@ void Meta::processSpecialCases(QString &line, Where &here){
 
     /* Legacy LPub backward compatibilty:  VIEW_ANGLE with CAMERA_ANGLES */
 
-    QRegExp viewAngleRx("^\\s*0.*\\s+(VIEW_ANGLE)\\s+.*$");
-    if (line.contains(viewAngleRx))
-        line.replace(viewAngleRx.cap(1),"CAMERA_ANGLES");
+    if (line.contains("VIEW_ANGLE")) {
+        QRegExp viewAngleRx("^\\s*0.*\\s+(VIEW_ANGLE)\\s+.*$");
+        if (line.contains(viewAngleRx))
+            line.replace(viewAngleRx.cap(1),"CAMERA_ANGLES");
+    }
 
     if (line.contains("CAMERA_DISTANCE_NATIVE")) {
         if (gui->parsedMessages.contains(here)) {
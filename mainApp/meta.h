@@ -316,21 +316,18 @@ public:
   virtual bool    preambleMatch(QStringList &argv, int index, QString &_preamble);
   virtual void    doc(QStringList &out, QString preamble);
   virtual void    pop();
+  /*
+   * The keywords in list are members of the derived class, so they
+   * are copied member-wise by the derived class copy and assignment.
+   * The list itself points to this instance's members and is kept.
+   */
   BranchMeta &operator= (const BranchMeta &rhs)
   {
-    QString key;
-    foreach(key, list.keys()) {
-      *list[key] = *rhs.list[key];
-    }
-    preamble = rhs.preamble;
+    AbstractMeta::operator=(rhs);
     return *this;
   }
   BranchMeta (const BranchMeta &rhs) : AbstractMeta(rhs)
   {
-    QString key;
-    foreach(key, list.keys()) {
-      *list[key] = *rhs.list[key];
-    }
   }
 };
 
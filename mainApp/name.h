@@ -446,6 +446,8 @@ static const SceneObject PliPartGroupSceneObjects[] =
 
 #define PAGE_DISPLAY_PAUSE_DEFAULT              3    // measured in seconds
 #define MAX_OPEN_WITH_PROGRAMS_DEFAULT          3    // maximum open with programs entries
+#define EXPORT_THREADS_DEFAULT                  1    // 1=serial export, 0=use all available cores
+#define PDF_PAGE_LOOK_AHEAD_DEFAULT             2    // pdf page images held ahead of the writer
 
 // Internal common material colours
 #define LDRAW_EDGE_MATERIAL_COLOUR              "24"
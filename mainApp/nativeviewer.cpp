@@ -1772,8 +1772,8 @@ bool Gui::getSelectedLine(int modelIndex, int lineIndex, int source, int &lineNu
 
         if (Preferences::debugLogging) {
             emit messageSig(LOG_TRACE, QString("Step lineIndex size: %1 item(s)")
-                                                .arg(currentStep->lineTypeIndexes.size()));
-            for (int i = 0; i < currentStep->lineTypeIndexes.size(); ++i)
+                                                .arg(currentStep->lineTypeIndexSize()));
+            for (int i = 0; i < currentStep->lineTypeIndexSize(); ++i)
                 emit messageSig(LOG_TRACE, QString("-Part lineNumber: [%1] at step line lineIndex [%2] - specified lineIndex [%3]")
                                                    .arg(currentStep->lineTypeIndexes.at(i)).arg(i).arg(lineIndex));
         }
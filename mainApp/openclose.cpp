@@ -482,6 +482,7 @@ void Gui::closeFile()
   setGoToPageCombo->setMaxCount(1000);
   setPageLineEdit->clear();
   pageSizes.clear();
+  clearPageCheckpoints();
   undoStack->clear();
   if (Preferences::enableFadeSteps || Preferences::enableHighlightStep)
       ldrawColourParts.clearGeneratedColorParts();
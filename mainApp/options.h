@@ -161,6 +161,7 @@ class Meta;
 class Where;
 class PgSizeData;
 class PliPartGroupMeta;
+class PageCheckpoint;
 
 class FindPageOptions
 {
@@ -176,7 +177,8 @@ public:
             int              _buildMod,
             int              _contStepNumber,
             int              _renderStepNumber  = 0,
-            QString          _renderParentModel = "")
+            QString          _renderParentModel = "",
+            PageCheckpoint  *_resume            = nullptr)
         :
           pageNum           (_pageNum),
           current           (_current),
@@ -187,7 +189,8 @@ public:
           buildMod          (_buildMod),
           contStepNumber    (_contStepNumber),
           renderStepNumber  (_renderStepNumber),
-          renderParentModel (_renderParentModel)
+          renderParentModel (_renderParentModel),
+          resume            (_resume)
     {  }
     int           &pageNum;
     Where         &current;
@@ -199,6 +202,7 @@ public:
     int            contStepNumber;
     int            renderStepNumber;
     QString        renderParentModel;
+    PageCheckpoint *resume;
 };
 
 class DrawPageOptions
@@ -29,6 +29,11 @@
 #include <QUrl>
 #include <QProcess>
 #include <QErrorMessage>
+#include <QPicture>
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <algorithm>
 
 #include "paths.h"
@@ -54,6 +59,82 @@ bool lessThan(const int &v1, const int &v2)
     return v1 < v2;
 }
 
+/*
+ * Parallel export. Page layout uses the Gui page state so drawPage stays on
+ * the GUI thread where the page scene is recorded to a QPicture. Recorded
+ * pages are then rasterized - and for image exports, encoded and saved - on
+ * a pool of export workers, each painting its own QImage. Pdf page images
+ * are written to the pdfWriter in page order from the GUI thread.
+ *
+ * Replaying a picture recreates the pixmaps drawn by the page items, so the
+ * workers are only used on the platform plugins known to support pixmaps
+ * outside the GUI thread. Otherwise pages are rasterized serially on the GUI
+ * thread.
+ */
+struct ExportPage {
+    QPicture picture;
+    QRectF   sceneRect;
+    QColor   fill;
+    qreal    dpr;
+    QString  fileName;
+    ExportPage()
+        : dpr(1.0)
+    {}
+    ExportPage(int widthPx, int heightPx, qreal _dpr, const QColor &_fill, const QString &_fileName = QString())
+        : sceneRect(0.0, 0.0, widthPx, heightPx),
+          fill(_fill),
+          dpr(_dpr),
+          fileName(_fileName)
+    {}
+};
+
+// platform plugins whose pixmaps are raster images usable from any thread
+static bool threadedPixmaps()
+{
+    static const QStringList threadedPlatforms = QStringList()
+            << "windows" << "cocoa" << "xcb" << "wayland" << "wayland-egl" << "offscreen" << "minimal";
+    return threadedPlatforms.contains(QGuiApplication::platformName(), Qt::CaseInsensitive);
+}
+
+static int exportThreadCount()
+{
+    if (! threadedPixmaps())
+        return 1;
+
+    int threads = Preferences::exportThreads;
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    return qMax(1, threads);
+}
+
+static void recordExportPage(LGraphicsScene &scene, ExportPage &page)
+{
+    QPainter painter;
+    painter.begin(&page.picture);
+    scene.render(&painter, page.sceneRect, page.sceneRect);
+    painter.end();
+}
+
+static QImage rasterizeExportPage(const ExportPage &page)
+{
+    QImage image(int(page.sceneRect.width()), int(page.sceneRect.height()), QImage::Format_ARGB32);
+    image.setDevicePixelRatio(page.dpr);
+    image.fill(page.fill);
+
+    QPainter painter;
+    painter.begin(&image);
+    painter.drawPicture(0, 0, page.picture);
+    painter.end();
+
+    // image exports are saved by the worker, only pdf pages are returned
+    if (! page.fileName.isEmpty()) {
+        image.save(page.fileName);
+        return QImage();
+    }
+
+    return image;
+}
+
 QPageLayout Gui::getPageLayout(bool nextPage){
 
   int pageNum = displayPageNum;
@@ -800,7 +881,12 @@ void Gui::exportAsPdf()
   // set export page elements or image
   bool exportPdfElements = !Preferences::pdfPageImage && dpr == 1.0;
 
-  QString messageIntro = exportPdfElements ? "Exporting page " : "Step 1. Creating image for page ";
+  QString messageIntro = exportPdfElements ? "Exporting page " : "Exporting image for page ";
+
+  // rasterize page images on a pool of export workers - pdf elements are painted directly
+  bool parallelExport = !exportPdfElements && exportThreadCount() > 1;
+  QThreadPool exportPool;
+  exportPool.setMaxThreadCount(exportThreadCount());
 
   // instantiate the scene and view
   LGraphicsScene scene;
@@ -824,14 +910,42 @@ void Gui::exportAsPdf()
   _displayPageNum = 0;
   _maxPages       = 0;
 
-  // page store
+  // rendered pages waiting to be written to the pdfWriter
   struct PdfPage {
       QImage image;
       float pageWidthIn;
       float pageHeightIn;
       QPageLayout pageLayout;
+      QFuture<QImage> future;
+      bool nextPage;
+  };
+  QQueue<PdfPage> pages;
+
+  // pages rendered ahead of the pdfWriter - serial export writes each page as it is rendered
+  int pageWindow = parallelExport ? exportThreadCount() + qMax(0, Preferences::pdfPageLookAhead) : 0;
+
+  // write queued page images beyond the window to the pdfWriter in page order, releasing each once written
+  QPainter pdfPainter;
+  auto writePdfPages = [&] (int window)
+  {
+      while (pages.size() > window) {
+          PdfPage pdfPage = pages.dequeue();
+          if (parallelExport)
+              pdfPage.image = pdfPage.future.result();
+
+          // render this page's image to the pdfWriter
+          pdfPainter.drawImage(QRect(0,0,
+                                   int(pdfWriter.logicalDpiX()*pdfPage.pageWidthIn),
+                                   int(pdfWriter.logicalDpiY()*pdfPage.pageHeightIn)),
+                                   pdfPage.image);
+
+          // prepare to render next page
+          if (pdfPage.nextPage) {
+              pdfWriter.setPageLayout(pdfPage.pageLayout);
+              pdfWriter.newPage();
+          }
+      }
   };
-  QMap<int, PdfPage> pages;
 
   m_progressDlgMessageLbl->setText("Exporting instructions to pdf...");
 
@@ -859,18 +973,24 @@ void Gui::exportAsPdf()
       if (exportPdfElements) {
          // initialize painter with pdfWriter
          painter.begin(&pdfWriter);
+      } else {
+         // initialize page image painter with pdfWriter
+         pdfPainter.begin(&pdfWriter);
       }
 
-      // step 1. generate page pixmaps
+      // generate page pixmaps - page images are streamed to the pdfWriter
       for (displayPageNum = _displayPageNum; displayPageNum <= _maxPages; displayPageNum++) {
 
           if (! exporting()) {
               if (exportPdfElements)
                   painter.end();
+              else
+                  pdfPainter.end();
               if (Preferences::modeGUI)
                   m_progressDialog->hide();
               displayPageNum = savePageNumber;
               drawPage(KpageView,KpageScene,false);
+              exportPool.clear();
               emit messageSig(LOG_STATUS,QString("Export to pdf terminated before completion."));
               return;
             }
@@ -897,8 +1017,11 @@ void Gui::exportAsPdf()
                         .arg(dpr);
 
           // initiialize the image
-          QImage image(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
-          image.setDevicePixelRatio(dpr);
+          QImage image;
+          if (!parallelExport) {
+              image = QImage(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
+              image.setDevicePixelRatio(dpr);
+          }
 
           // set up the view - use unscaled page size
           QRectF boundingRect(0.0, 0.0, int(pageWidthPx),int(pageHeightPx));
@@ -916,7 +1039,7 @@ void Gui::exportAsPdf()
           clearPage(&view,&scene);
 
           // paint to the image the scene we view
-          if (!exportPdfElements) {
+          if (!exportPdfElements && !parallelExport) {
               // initialize painter with image
               painter.begin(&image);
               // clear the pixels of the image
@@ -926,7 +1049,11 @@ void Gui::exportAsPdf()
           // render this page
           drawPage(&view,&scene,true);
           scene.setSceneRect(0.0,0.0,adjPageWidthPx,adjPageHeightPx);
-          scene.render(&painter);
+          ExportPage exportPage(adjPageWidthPx, adjPageHeightPx, dpr, Qt::white);
+          if (parallelExport)
+              recordExportPage(scene, exportPage);
+          else
+              scene.render(&painter);
           clearPage(&view,&scene);
 
           if (exportPdfElements) {
@@ -941,23 +1068,25 @@ void Gui::exportAsPdf()
               getExportPageSize(pageWidthIn, pageHeightIn, Inches);
               PdfPage pdfPage;
               pdfPage.image       = image;
+              if (parallelExport)
+                  pdfPage.future  = QtConcurrent::run(&exportPool, rasterizeExportPage, exportPage);
               pdfPage.pageWidthIn  = pageWidthIn;
               pdfPage.pageHeightIn = pageHeightIn;
 
               // store pdfWriter next page layout
-              if(displayPageNum < _maxPages) {
+              pdfPage.nextPage     = displayPageNum < _maxPages;
+              if(pdfPage.nextPage) {
                   bool nextPage = true;
                   pdfPage.pageLayout = getPageLayout(nextPage);
               }
 
-              // store the rendered page
-              QMap<int, PdfPage>::iterator i = pages.find(displayPageNum);
-              if (i != pages.end())
-                  pages.erase(i);
-              pages.insert(displayPageNum,pdfPage);
-
               // wrap up paint to image
-              painter.end();
+              if (!parallelExport)
+                  painter.end();
+
+              // queue the rendered page and write the pages beyond the look-ahead window
+              pages.enqueue(pdfPage);
+              writePdfPages(pageWindow);
           }
       }
 
@@ -967,45 +1096,11 @@ void Gui::exportAsPdf()
           // wrap up paint to pdfWriter
           painter.end();
       } else {
-          // step 2. paint generated page pixmaps to the pdfWriter
-          painter.begin(&pdfWriter);
-
-          m_progressDlgProgressBar->setRange(1,pages.count());
-
-          int page;
-          foreach (page, pages.keys()) {
-              m_progressDlgMessageLbl->setText(QString("Step 2. Exporting pdf document page %1 of %2")
-                                               .arg(page)
-                                               .arg(pages.count()));
-              m_progressDlgProgressBar->setValue(page);
-              QApplication::processEvents();
-
-              if (! exporting()) {
-                      painter.end();
-                  if (Preferences::modeGUI)
-                      m_progressDialog->hide();
-                  emit messageSig(LOG_STATUS,QString("Export to pdf terminated before completion."));
-                  return;
-                }
-
-              // render this page's image to the pdfWriter
-              painter.drawImage(QRect(0,0,
-                                       int(pdfWriter.logicalDpiX()*pages[page].pageWidthIn),
-                                       int(pdfWriter.logicalDpiY()*pages[page].pageHeightIn)),
-                                       pages[page].image);
-
-              // prepare to render next page
-              if(page < pages.count()) {
-                  pdfWriter.setPageLayout(pages[page].pageLayout);
-                  pdfWriter.newPage();
-              }
-          }
-
-          m_progressDlgProgressBar->setValue(pages.count());
+          // write the pages remaining in the look-ahead window
+          writePdfPages(0);
 
           // wrap up paint to pdfWriter
-          pages.clear();
-          painter.end();
+          pdfPainter.end();
       }
 
     } else {
@@ -1041,9 +1136,12 @@ void Gui::exportAsPdf()
       if (exportPdfElements) {
          // initialize painter with pdfWriter
          painter.begin(&pdfWriter);
+      } else {
+         // initialize page image painter with pdfWriter
+         pdfPainter.begin(&pdfWriter);
       }
 
-      // step 1. generate page pixmaps
+      // generate page pixmaps - page images are streamed to the pdfWriter
       foreach(int printPage,printPages){
 
           _pageCount++;
@@ -1051,10 +1149,13 @@ void Gui::exportAsPdf()
           if (! exporting()) {
               if (exportPdfElements)
                   painter.end();
+              else
+                  pdfPainter.end();
               if (Preferences::modeGUI)
                   m_progressDialog->hide();
               displayPageNum = savePageNumber;
               drawPage(KpageView,KpageScene,false);
+              exportPool.clear();
               emit messageSig(LOG_STATUS,QString("Export to pdf terminated before completion."));
               return;
             }
@@ -1086,8 +1187,11 @@ void Gui::exportAsPdf()
                         .arg(int(resolution()));              //8
 
           // initiialize the image
-          QImage image(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
-          image.setDevicePixelRatio(dpr);
+          QImage image;
+          if (!parallelExport) {
+              image = QImage(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
+              image.setDevicePixelRatio(dpr);
+          }
 
           // set up the view - use unscaled page size
           QRectF boundingRect(0.0, 0.0, int(pageWidthPx),int(pageHeightPx));
@@ -1105,7 +1209,7 @@ void Gui::exportAsPdf()
           clearPage(&view,&scene);
 
           // paint to the image the scene we view
-          if (!exportPdfElements) {
+          if (!exportPdfElements && !parallelExport) {
               // initialize painter with image
               painter.begin(&image);
               // clear the pixels of the image
@@ -1115,7 +1219,11 @@ void Gui::exportAsPdf()
           // render this page
           drawPage(&view,&scene,true);
           scene.setSceneRect(0.0,0.0,adjPageWidthPx,adjPageHeightPx);
-          scene.render(&painter);
+          ExportPage exportPage(adjPageWidthPx, adjPageHeightPx, dpr, Qt::white);
+          if (parallelExport)
+              recordExportPage(scene, exportPage);
+          else
+              scene.render(&painter);
           clearPage(&view,&scene);
 
           if (exportPdfElements) {
@@ -1130,23 +1238,25 @@ void Gui::exportAsPdf()
               getExportPageSize(pageWidthIn, pageHeightIn, Inches);
               PdfPage pdfPage;
               pdfPage.image       = image;
+              if (parallelExport)
+                  pdfPage.future  = QtConcurrent::run(&exportPool, rasterizeExportPage, exportPage);
               pdfPage.pageWidthIn  = pageWidthIn;
               pdfPage.pageHeightIn = pageHeightIn;
 
               // store pdfWriter next page layout
-              if(_pageCount < printPages.count()) {
+              pdfPage.nextPage     = _pageCount < printPages.count();
+              if(pdfPage.nextPage) {
                   bool nextPage = true;
                   pdfPage.pageLayout = getPageLayout(nextPage);
               }
 
-              // store the rendered page
-              QMap<int, PdfPage>::iterator i = pages.find(displayPageNum);
-              if (i != pages.end())
-                  pages.erase(i);
-              pages.insert(displayPageNum,pdfPage);
-
               // wrap up
-              painter.end();
+              if (!parallelExport)
+                  painter.end();
+
+              // queue the rendered page and write the pages beyond the look-ahead window
+              pages.enqueue(pdfPage);
+              writePdfPages(pageWindow);
           }
       }
 
@@ -1156,45 +1266,11 @@ void Gui::exportAsPdf()
           // wrap up paint to pdfWriter
           painter.end();
       } else {
-          // step 2. paint generated page pixmaps to the pdfWriter
-          painter.begin(&pdfWriter);
-
-          m_progressDlgProgressBar->setRange(1,pages.count());
-
-          int page;
-          foreach (page, pages.keys()) {
-              m_progressDlgMessageLbl->setText(QString("Step 2. Exporting pdf document page %1 of %2")
-                                               .arg(page)
-                                               .arg(pages.count()));
-              m_progressDlgProgressBar->setValue(page);
-              QApplication::processEvents();
-
-              if (! exporting()) {
-                  painter.end();
-                  if (Preferences::modeGUI)
-                      m_progressDialog->hide();
-                  emit messageSig(LOG_STATUS,QString("Export to pdf terminated before completion."));
-                  return;
-              }
-
-              // render this page's image to the pdfWriter
-              painter.drawImage(QRect(0,0,
-                                 int(pdfWriter.logicalDpiX()*pages[page].pageWidthIn),
-                                 int(pdfWriter.logicalDpiY()*pages[page].pageHeightIn)),
-                                 pages[page].image);
-
-              // prepare to render next page
-              if(page < pages.count()) {
-                  pdfWriter.setPageLayout(pages[page].pageLayout);
-                  pdfWriter.newPage();
-              }
-          }
-
-          m_progressDlgProgressBar->setValue(pages.count());
+          // write the pages remaining in the look-ahead window
+          writePdfPages(0);
 
           // wrap up paint to pdfWriter
-          pages.clear();
-          painter.end();
+          pdfPainter.end();
       }
   }
 
@@ -1341,6 +1417,12 @@ void Gui::exportAs(const QString &_suffix)
   // calculate device pixel ratio
   qreal dpr = exportPixelRatio;
 
+  // rasterize and save page images on a pool of export workers
+  bool parallelExport = !exportingObjects() && exportThreadCount() > 1;
+  QThreadPool exportPool;
+  exportPool.setMaxThreadCount(exportThreadCount());
+  QQueue<QFuture<QImage> > pendingPages;
+
   // initialize progress dialogue
   m_progressDialog->setAutoHide(true);
   m_progressDialog->setWindowTitle(QString("Export as %1 %2").arg(suffix).arg(type));
@@ -1369,6 +1451,8 @@ void Gui::exportAs(const QString &_suffix)
                   m_progressDialog->hide();
               displayPageNum = savePageNumber;
               drawPage(KpageView,KpageScene,false);
+              exportPool.clear();
+              exportPool.waitForDone();
               emit messageSig(LOG_STATUS,QString("Export terminated before completion."));
               return;
             }
@@ -1404,11 +1488,13 @@ void Gui::exportAs(const QString &_suffix)
                              .arg(suffix);
 
               // paint to the image the scene we view
-              QImage image(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
-              image.setDevicePixelRatio(dpr);
-
+              QImage image;
               QPainter painter;
-              painter.begin(&image);
+              if (!parallelExport) {
+                  image = QImage(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
+                  image.setDevicePixelRatio(dpr);
+                  painter.begin(&image);
+              }
 
               // set up the view
               QRectF boundingRect(0.0, 0.0, int(pageWidthPx),int(pageHeightPx));
@@ -1429,20 +1515,34 @@ void Gui::exportAs(const QString &_suffix)
               // transparent or uses a PNG image with transparency. This will
               // prevent rendered pixels from each page layering on top of each
               // other.
-              image.fill(fillPng ? Qt::transparent : Qt::white);
+              if (!parallelExport)
+                  image.fill(fillPng ? Qt::transparent : Qt::white);
 
               // render this page
               // scene.render instead of view.render resolves "warm up" issue
               drawPage(&view,&scene,true);
-              scene.setSceneRect(0.0,0.0,image.width(),image.height());
-              scene.render(&painter);
-              clearPage(&view,&scene);
+              scene.setSceneRect(0.0,0.0,adjPageWidthPx,adjPageHeightPx);
 
               // save the image to the selected directory
               // internationalization of "_page_"?
               QString pn = QString("%1") .arg(displayPageNum);
-              image.save( QDir::toNativeSeparators(directoryName + "/" + baseName + "_page_" + pn + suffix));
-              painter.end();
+              QString imageFile = QDir::toNativeSeparators(directoryName + "/" + baseName + "_page_" + pn + suffix);
+
+              if (parallelExport) {
+                  // record the page then rasterize and save it on an export worker
+                  ExportPage exportPage(adjPageWidthPx, adjPageHeightPx, dpr,
+                                        fillPng ? Qt::transparent : Qt::white, imageFile);
+                  recordExportPage(scene, exportPage);
+                  pendingPages.enqueue(QtConcurrent::run(&exportPool, rasterizeExportPage, exportPage));
+                  // limit the number of recorded pages waiting on a worker
+                  while (pendingPages.size() > exportPool.maxThreadCount() * 2)
+                      pendingPages.dequeue().waitForFinished();
+              } else {
+                  scene.render(&painter);
+                  image.save(imageFile);
+                  painter.end();
+              }
+              clearPage(&view,&scene);
           }
       }
       m_progressDlgProgressBar->setValue(_maxPages);
@@ -1477,6 +1577,8 @@ void Gui::exportAs(const QString &_suffix)
                   m_progressDialog->hide();
               displayPageNum = savePageNumber;
               drawPage(KpageView,KpageScene,false);
+              exportPool.clear();
+              exportPool.waitForDone();
               emit messageSig(LOG_STATUS,QString("Export terminated before completion."));
               return;
           }
@@ -1515,11 +1617,13 @@ void Gui::exportAs(const QString &_suffix)
                              .arg(suffix);
 
               // paint to the image the scene we view
-              QImage image(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
-              image.setDevicePixelRatio(dpr);
-
+              QImage image;
               QPainter painter;
-              painter.begin(&image);
+              if (!parallelExport) {
+                  image = QImage(adjPageWidthPx, adjPageHeightPx, QImage::Format_ARGB32);
+                  image.setDevicePixelRatio(dpr);
+                  painter.begin(&image);
+              }
 
               QRectF boundingRect(0.0, 0.0, int(pageWidthPx),int(pageHeightPx));
               QRect bounding(0, 0, int(pageWidthPx),int(pageHeightPx));
@@ -1539,25 +1643,42 @@ void Gui::exportAs(const QString &_suffix)
               // transparent or uses a PNG image with transparency. This will
               // prevent rendered pixels from each page layering on top of each
               // other.
-              image.fill(fillPng ? Qt::transparent : Qt::white);
+              if (!parallelExport)
+                  image.fill(fillPng ? Qt::transparent : Qt::white);
 
               // render this page
               // scene.render instead of view.render resolves "warm up" issue
               drawPage(&view,&scene,true);
-              scene.setSceneRect(0.0,0.0,image.width(),image.height());
-              scene.render(&painter);
-              clearPage(&view,&scene);
+              scene.setSceneRect(0.0,0.0,adjPageWidthPx,adjPageHeightPx);
 
               // save the image to the selected directory
               // internationalization of "_page_"?
               QString pn = QString("%1") .arg(displayPageNum);
-              image.save( QDir::toNativeSeparators(directoryName + "/" + baseName + "_page_" + pn + suffix));
-              painter.end();
+              QString imageFile = QDir::toNativeSeparators(directoryName + "/" + baseName + "_page_" + pn + suffix);
+
+              if (parallelExport) {
+                  // record the page then rasterize and save it on an export worker
+                  ExportPage exportPage(adjPageWidthPx, adjPageHeightPx, dpr,
+                                        fillPng ? Qt::transparent : Qt::white, imageFile);
+                  recordExportPage(scene, exportPage);
+                  pendingPages.enqueue(QtConcurrent::run(&exportPool, rasterizeExportPage, exportPage));
+                  // limit the number of recorded pages waiting on a worker
+                  while (pendingPages.size() > exportPool.maxThreadCount() * 2)
+                      pendingPages.dequeue().waitForFinished();
+              } else {
+                  scene.render(&painter);
+                  image.save(imageFile);
+                  painter.end();
+              }
+              clearPage(&view,&scene);
           }
       }
       m_progressDlgProgressBar->setValue(printPages.count());
     }
 
+  // wait for the export workers to save the remaining pages
+  exportPool.waitForDone();
+
   // hide progress bar
   if (Preferences::modeGUI)
       m_progressDialog->hide();
@@ -68,6 +68,7 @@ Step::Step(
   submodelLevel             = _meta.submodelStack.size();
   stepNumber.number         =  num;             // record step number
   csiItem                   = nullptr;
+  lineTypeIndexCount        = 0;
   adjustOnItemOffset        = false;
 
   modelDisplayOnlyStep      = false;
@@ -246,7 +247,7 @@ int Step::createCsi(
   bool    absRotstep    = meta.rotStep.value().type == "ABS";
   bool    useImageSize  = csiStepMeta.imageSize.value(0) > 0;
   FloatPairMeta noCA;
-  lineTypeIndexes       =_lineTypeIndexes;
+  lineTypeIndexCount    =_lineTypeIndexes.size(); // drawPage shares the list once the page is done
 
   ldrName.clear();
 
@@ -545,13 +546,13 @@ bool Step::loadTheViewer(){
 }
 
 int Step::getLineTypeRelativeIndex(int lineTypeIndx){
-    if (lineTypeIndexes.size() > lineTypeIndx)
+    if (lineTypeIndx >= 0 && lineTypeIndexSize() > lineTypeIndx)
         return lineTypeIndexes.at(lineTypeIndx);
     return -1;
 }
 
 int Step::getLineTypeIndex(int relativeTypeIndx){
-    for (int i = 0; i < lineTypeIndexes.size(); ++i)
+    for (int i = 0; i < lineTypeIndexSize(); ++i)
         if (lineTypeIndexes.at(i) == relativeTypeIndx)
             return i;
     return -1;
@@ -64,7 +64,8 @@ class Step : public AbstractRangeElement
     DividerType           dividerType;
     QList<Callout *>      list;
     QList<CsiAnnotation*> csiAnnotations;
-    QVector<int>          lineTypeIndexes;
+    QVector<int>          lineTypeIndexes;    // the page's index list, the first lineTypeIndexCount are this step's
+    int                   lineTypeIndexCount;
     Pli                   pli;
     SubModel              subModel;
     CsiItem              *csiItem;
@@ -130,6 +131,10 @@ class Step : public AbstractRangeElement
     bool loadTheViewer();
     int  getLineTypeRelativeIndex(int lineTypeIndx);
     int  getLineTypeIndex(int relativeTypeIndx);
+    int  lineTypeIndexSize()
+    {
+      return qMin(lineTypeIndexCount, lineTypeIndexes.size());
+    }
 
     MetaItem *mi(int which = -1)
     {
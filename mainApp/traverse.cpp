@@ -36,6 +36,8 @@
 #include <QGraphicsItem>
 #include <QString>
 #include <QFileInfo>
+#include <QCryptographicHash>
+#include <QtConcurrent>
 #include "lpub_preferences.h"
 #include "ranges.h"
 #include "callout.h"
@@ -59,6 +61,61 @@
 #define FIRST_STEP 1
 #define FIRST_PAGE 1
 
+/*
+ * Constructing a Meta builds its whole syntax tree, which findPage did for
+ * its saved meta and for every submodel it entered. MetaScope instead hands
+ * out Meta trees from a stack that is kept between traversals, so a scope
+ * only assigns the leaf values it takes from its parent.
+ */
+class MetaScope
+{
+public:
+  MetaScope()
+  {
+    if (depth == pool.size())
+      pool.append(new Meta);
+    scope = pool[depth++];
+  }
+  ~MetaScope()
+  {
+    --depth;
+  }
+  Meta &meta()
+  {
+    return *scope;
+  }
+
+  /* Take the same state from rhs as the Meta copy constructor */
+  Meta &inherit(const Meta &rhs)
+  {
+    static const Meta defaults;
+    scope->pushed        = rhs.pushed;
+    scope->global        = rhs.global;
+    scope->LPub          = rhs.LPub;
+    scope->step          = rhs.step;
+    scope->clear         = rhs.clear;
+    scope->rotStep       = rhs.rotStep;
+    scope->LSynth        = rhs.LSynth;
+    scope->submodelStack = rhs.submodelStack;
+    scope->fade          = defaults.fade;
+    scope->silhouette    = defaults.silhouette;
+    scope->colour        = defaults.colour;
+    scope->bfx           = defaults.bfx;
+    scope->MLCad         = defaults.MLCad;
+    scope->LDCad         = defaults.LDCad;
+    scope->LeoCad        = defaults.LeoCad;
+    return *scope;
+  }
+
+private:
+  Meta               *scope;
+  static QList<Meta *> pool;
+  static int           depth;
+};
+
+QList<Meta *> MetaScope::pool;
+int           MetaScope::depth = 0;
+
 static QString AttributeNames[] =
 {
     "Line",
@@ -402,6 +459,100 @@ static void set_divider_pointers(
  *
  */
 
+/*
+ * A step's line type indexes are the leading entries of the page's
+ * index list. Sharing the list with the step as soon as its CSI is
+ * created would make the next part line copy the whole list, so the
+ * steps are handed the list only when it is about to be cleared or
+ * replaced (CLEAR, BUFEXCHG RETRIEVE, REMOVE) or the page is done.
+ */
+class LineTypeIndexSharing
+{
+public:
+  LineTypeIndexSharing(QVector<int> &_lineTypeIndexes)
+    : lineTypeIndexes(_lineTypeIndexes)
+  {  }
+  ~LineTypeIndexSharing()
+  {
+    share();
+  }
+  void append(Step *step)
+  {
+    steps << step;
+  }
+  void share()
+  {
+    for (Step *step : steps)
+      step->lineTypeIndexes = lineTypeIndexes;
+    steps.clear();
+  }
+private:
+  QVector<int> &lineTypeIndexes;
+  QList<Step *> steps;
+};
+
+/*
+ * findPage copies the cumulative CSI part list at step boundaries (the
+ * save state handed to drawPage) and at page checkpoints. Between a
+ * CLEAR, BUFEXCHG RETRIEVE or REMOVE the list only grows, so each copy
+ * is a prefix of it. Sharing the list there would make the next part
+ * line copy it whole, so a copy is recorded as a length and cut from
+ * the list only when the list is about to be cleared or replaced, or
+ * the copy is read - take() must come first in each of those places.
+ */
+class DeferredPartsCopies
+{
+public:
+  DeferredPartsCopies(QStringList &_csiParts, QVector<int> &_lineTypeIndexes)
+    : csiParts(_csiParts), lineTypeIndexes(_lineTypeIndexes)
+  {  }
+  ~DeferredPartsCopies()
+  {
+    take();
+  }
+  void copy(QStringList       &toCsiParts,
+            QVector<int>      &toLineTypeIndexes,
+            const QStringList &fromCsiParts,
+            const QVector<int>&fromLineTypeIndexes)
+  {
+    int from = -1;
+    for (int i = 0; i < copies.size(); i++) {
+      if (copies[i].csiParts == &toCsiParts) {
+        copies.removeAt(i--);
+      } else if (copies[i].csiParts == &fromCsiParts) {
+        from = i;
+      }
+    }
+    if (&fromCsiParts == &csiParts) {
+      copies.append({ &toCsiParts, &toLineTypeIndexes, csiParts.size(), lineTypeIndexes.size() });
+    } else if (from >= 0) {
+      Copy fromCopy = copies[from];
+      copies.append({ &toCsiParts, &toLineTypeIndexes, fromCopy.csiPartsSize, fromCopy.lineTypeIndexesSize });
+    } else {
+      toCsiParts        = fromCsiParts;
+      toLineTypeIndexes = fromLineTypeIndexes;
+    }
+  }
+  void take()
+  {
+    for (const Copy &copy : copies) {
+      *copy.csiParts        = csiParts.mid(0, copy.csiPartsSize);
+      *copy.lineTypeIndexes = lineTypeIndexes.mid(0, copy.lineTypeIndexesSize);
+    }
+    copies.clear();
+  }
+private:
+  struct Copy {
+    QStringList  *csiParts;
+    QVector<int> *lineTypeIndexes;
+    int           csiPartsSize;
+    int           lineTypeIndexesSize;
+  };
+  QStringList  &csiParts;
+  QVector<int> &lineTypeIndexes;
+  QList<Copy>   copies;
+};
+
 Range *newRange(
     Steps  *steps,
     bool    calledOut)
@@ -433,7 +584,7 @@ int Gui::drawPage(
   Callout *callout         = nullptr;
   Range   *range           = nullptr;
   Step    *step            = nullptr;
-  int      numLines        = ldrawFile.size(opts.current.modelName);
+  int      numLines        = ldrawFile.size(opts.current);
   bool     pliIgnore       = false;
   bool     partIgnore      = false;
   bool     synthBegin      = false;
@@ -466,6 +617,8 @@ int Gui::drawPage(
      buildModIgnore,
      buildModItems);
 
+  LineTypeIndexSharing stepLineTypeIndexes(opts.lineTypeIndexes);
+
   DividerType dividerType  = NoDivider;
 
   PagePointer *pagePointer = nullptr;
@@ -582,7 +735,7 @@ int Gui::drawPage(
 
           // read the line from the ldrawFile db
 
-          line = ldrawFile.readLine(opts.current.modelName,opts.current.lineNumber);
+          line = ldrawFile.readLine(opts.current);
           split(line,tokens);
         }
 
@@ -718,7 +871,7 @@ int Gui::drawPage(
                   Where walk = opts.current;
                   for (++walk; walk < numLines; ++walk) {
                       QStringList tokens;
-                      QString scanLine = ldrawFile.readLine(walk.modelName,walk.lineNumber);
+                      QString scanLine = ldrawFile.readLine(walk);
                       split(scanLine,tokens);
                       if (tokens.size() > 0 && tokens[0] == "0") {
                           Rc rc = tmpMeta.parse(scanLine,walk,false);
@@ -877,6 +1030,7 @@ int Gui::drawPage(
           switch (rc) {
             /* toss it all out the window, per James' original plan */
             case ClearRc:
+              stepLineTypeIndexes.share();
               opts.pliParts.clear();
               opts.csiParts.clear();
               opts.lineTypeIndexes.clear();
@@ -893,6 +1047,7 @@ int Gui::drawPage(
               break;
 
             case BufferLoadRc:
+              stepLineTypeIndexes.share();
               opts.csiParts = opts.bfx[curMeta.bfx.value()];
               opts.lineTypeIndexes = opts.bfxLineTypeIndexes[curMeta.bfx.value()];
               if (!partsAdded) {
@@ -904,7 +1059,7 @@ int Gui::drawPage(
 
             case BuildModBeginRc:
               buildModKey    = curMeta.LPub.buildMod.value();
-              opts.buildMod  = getLevel(buildModKey,HiarchLevel::BEGIN);
+              opts.buildMod  = ldrawFile.buildModLevel(opts.current,BuildModBlock::EndClose);
               buildModAction = getBuildModAction(buildModKey, opts.stepNum);
               if (buildModAction == BuildModApplyRc){
                   buildModIgnore    = false;
@@ -915,7 +1070,7 @@ int Gui::drawPage(
               break;
 
             case BuildModEndRc:
-              opts.buildMod  = getLevel(QString(),HiarchLevel::END);
+              opts.buildMod  = ldrawFile.buildModLevel(opts.current,BuildModBlock::EndClose);
               buildModIgnore = buildModPliIgnore = false;
               break;
 
@@ -1066,6 +1221,7 @@ int Gui::drawPage(
                 } else {
                     remove_partname(opts.csiParts,opts.lineTypeIndexes,curMeta.LPub.remove.partname.value(),newCSIParts,newLineTypeIndexes);
                 }
+                stepLineTypeIndexes.share();
                 opts.csiParts = newCSIParts;
                 opts.lineTypeIndexes = newLineTypeIndexes;
 
@@ -1808,6 +1964,8 @@ int Gui::drawPage(
                         &step->csiPixmap,
                         steps->meta,
                         bfxLoad);
+                  stepLineTypeIndexes.append(step);
+                  configuredCsiParts.clear(); // keep opts.csiParts unshared for the next part line
 
                   if (renderer->useLDViewSCall() && ! step->ldrName.isNull()) {
                       opts.ldrStepFiles << step->ldrName;
@@ -1946,6 +2104,8 @@ int Gui::drawPage(
                                   opts.lineTypeIndexes,
                                   &step->csiPixmap,
                                   steps->meta);
+                      stepLineTypeIndexes.append(step);
+                      configuredCsiParts.clear();
 
                       if (rc) {
                           emit messageSig(LOG_ERROR, QMessageBox::tr("Failed to create CSI file."));
@@ -2167,7 +2327,7 @@ int Gui::drawPage(
 int Gui::findPage(
     LGraphicsView   *view,
     LGraphicsScene  *scene,
-    Meta             meta,
+    Meta            &meta,
     QString const   &addLine,
     FindPageOptions &opts)
 {
@@ -2192,11 +2352,13 @@ int Gui::findPage(
   int  partsAdded = 0;
   int  stepNumber = 1;
 
-  skipHeader(opts.current);
+  if (! opts.resume) {
+      skipHeader(opts.current);
 
-  if (opts.pageNum == 1) {
-      topOfPages.clear();
-      topOfPages.append(opts.current);
+      if (opts.pageNum == 1) {
+          topOfPages.clear();
+          topOfPages.append(opts.current);
+      }
   }
 
   QStringList  csiParts;
@@ -2222,9 +2384,12 @@ int Gui::findPage(
   buildModIgnore,
   buildModItems);
 
+  DeferredPartsCopies partsCopies(csiParts, lineTypeIndexes);
+
   saveStepPageNum = stepPageNum;
 
-  Meta        saveMeta = meta;
+  MetaScope   saveMetaScope;
+  Meta       &saveMeta = saveMetaScope.inherit(meta);
 
   QHash<QString, QStringList>  bfx;
   QHash<QString, QStringList>  saveBfx;
@@ -2232,7 +2397,7 @@ int Gui::findPage(
   QHash<QString, QVector<int>> saveBfxLineTypeIndexes;
   QList<PliPartGroupMeta>      emptyPartGroups;
 
-  int numLines = ldrawFile.size(opts.current.modelName);
+  int numLines = ldrawFile.size(opts.current);
 
   int  countInstances = meta.LPub.countInstance.value();
 
@@ -2240,6 +2405,126 @@ int Gui::findPage(
 
   RotStepMeta saveRotStep = meta.rotStep;
 
+  bool topOfNextPage = false;
+  bool endOfPages    = false;
+
+  /*
+   * Page checkpoints are only captured for the top level model, at the
+   * top of a page that precedes or is the display page. Past the display
+   * page the csiParts, bfx and remove handling is skipped, so the state
+   * would not match that of a traversal started from line 0.
+   */
+  auto savePageCheckpoint = [&] ()
+  {
+      if (! recordPageCheckpoints ||
+          ! meta.submodelStack.isEmpty() ||
+            opts.pageNum > displayPageNum ||
+            pageCheckpoints.contains(opts.pageNum))
+          return;
+
+      PageCheckpoint *cp = new PageCheckpoint;
+      cp->current                = opts.current;
+      cp->saveCurrent            = saveCurrent;
+      cp->topOfStep              = topOfStep;
+      cp->stepGroupCurrent       = stepGroupCurrent;
+      cp->meta                   = meta;
+      cp->saveMeta               = saveMeta;
+      cp->saveRotStep            = saveRotStep;
+      cp->pageSize               = opts.pageSize;
+      cp->defaultPageSize        = pageSizes.value(DEF_SIZE);
+      partsCopies.copy(cp->csiParts, cp->lineTypeIndexes, csiParts, lineTypeIndexes);
+      partsCopies.copy(cp->saveCsiParts, cp->saveLineTypeIndexes, saveCsiParts, saveLineTypeIndexes);
+      cp->bfxParts               = bfxParts;
+      cp->saveBfxParts           = saveBfxParts;
+      cp->bfx                    = bfx;
+      cp->saveBfx                = saveBfx;
+      cp->bfxLineTypeIndexes     = bfxLineTypeIndexes;
+      cp->saveBfxLineTypeIndexes = saveBfxLineTypeIndexes;
+      cp->renderedState          = ldrawFile.getRenderedState();
+      cp->buildModKey            = buildModKey;
+      cp->buildModAction         = buildModAction;
+      cp->buildModIgnore         = buildModIgnore;
+      cp->buildMod               = opts.buildMod;
+      cp->stepNumber             = stepNumber;
+      cp->saveStepNumber         = saveStepNumber;
+      cp->partsAdded             = partsAdded;
+      cp->countInstances         = countInstances;
+      cp->contStepNumber         = opts.contStepNumber;
+      cp->stepPageNum            = stepPageNum;
+      cp->saveStepPageNum        = saveStepPageNum;
+      cp->saveContStepNum        = saveContStepNum;
+      cp->firstStepPageNum       = firstStepPageNum;
+      cp->lastStepPageNum        = lastStepPageNum;
+      cp->stepGroup              = stepGroup;
+      cp->partIgnore             = partIgnore;
+      cp->coverPage              = coverPage;
+      cp->stepPage               = stepPage;
+      cp->bfxStore1              = bfxStore1;
+      cp->bfxStore2              = bfxStore2;
+      cp->callout                = callout;
+      cp->noStep                 = noStep;
+      cp->noStep2                = noStep2;
+      cp->stepGroupBfxStore2     = stepGroupBfxStore2;
+      cp->pageSizeUpdate         = pageSizeUpdate;
+      cp->enableLineTypeIndexes  = Preferences::enableLineTypeIndexes;
+      pageCheckpoints.insert(opts.pageNum, cp);
+  };
+
+  // restore the traversal state from the page checkpoint
+  if (opts.resume) {
+      PageCheckpoint *cp     = opts.resume;
+      opts.current           = cp->current;
+      saveCurrent            = cp->saveCurrent;
+      topOfStep              = cp->topOfStep;
+      stepGroupCurrent       = cp->stepGroupCurrent;
+      meta                   = cp->meta;
+      saveMeta               = cp->saveMeta;
+      saveRotStep            = cp->saveRotStep;
+      opts.pageSize          = cp->pageSize;
+      csiParts               = cp->csiParts;
+      saveCsiParts           = cp->saveCsiParts;
+      lineTypeIndexes        = cp->lineTypeIndexes;
+      saveLineTypeIndexes    = cp->saveLineTypeIndexes;
+      bfxParts               = cp->bfxParts;
+      saveBfxParts           = cp->saveBfxParts;
+      bfx                    = cp->bfx;
+      saveBfx                = cp->saveBfx;
+      bfxLineTypeIndexes     = cp->bfxLineTypeIndexes;
+      saveBfxLineTypeIndexes = cp->saveBfxLineTypeIndexes;
+      buildModKey            = cp->buildModKey;
+      buildModAction         = cp->buildModAction;
+      buildModIgnore         = cp->buildModIgnore;
+      opts.buildMod          = cp->buildMod;
+      stepNumber             = cp->stepNumber;
+      saveStepNumber         = cp->saveStepNumber;
+      partsAdded             = cp->partsAdded;
+      countInstances         = cp->countInstances;
+      opts.contStepNumber    = cp->contStepNumber;
+      stepPageNum            = cp->stepPageNum;
+      saveStepPageNum        = cp->saveStepPageNum;
+      saveContStepNum        = cp->saveContStepNum;
+      firstStepPageNum       = cp->firstStepPageNum;
+      lastStepPageNum        = cp->lastStepPageNum;
+      stepGroup              = cp->stepGroup;
+      partIgnore             = cp->partIgnore;
+      coverPage              = cp->coverPage;
+      stepPage               = cp->stepPage;
+      bfxStore1              = cp->bfxStore1;
+      bfxStore2              = cp->bfxStore2;
+      callout                = cp->callout;
+      noStep                 = cp->noStep;
+      noStep2                = cp->noStep2;
+      stepGroupBfxStore2     = cp->stepGroupBfxStore2;
+      pageSizeUpdate         = cp->pageSizeUpdate;
+      Preferences::enableLineTypeIndexes = cp->enableLineTypeIndexes;
+      ldrawFile.setRenderedState(cp->renderedState);
+      if (exporting()) {
+          pageSizes.remove(DEF_SIZE);
+          pageSizes.insert(DEF_SIZE,cp->defaultPageSize);
+      }
+      ++opts.current;   // the checkpoint line was processed before the checkpoint was taken
+  }
+
   emit messageSig(LOG_INFO_STATUS, "Processing find page for " + opts.current.modelName + "...");
 
   ldrawFile.setRendered(opts.current.modelName, opts.isMirrored, opts.renderParentModel, opts.renderStepNumber, countInstances);
@@ -2276,10 +2561,20 @@ int Gui::findPage(
         opts.current.lineNumber < numLines;
         opts.current.lineNumber++) {
 
+      // the display page is drawn and the page checkpoints still
+      // describe the rest of the unedited document, so stop here
+      if (recordPageCheckpoints &&
+          pageCheckpointsComplete &&
+          meta.submodelStack.isEmpty() &&
+          opts.pageNum > displayPageNum) {
+          endOfPages = true;
+          break;
+      }
+
       // scan through the rest of the model counting pages
       // if we've already hit the display page, then do as little as possible
 
-      QString line = ldrawFile.readLine(opts.current.modelName,opts.current.lineNumber).trimmed();
+      QString line = ldrawFile.readLine(opts.current).trimmed();
 
       if (line.startsWith("0 GHOST ")) {
           line = line.mid(8).trimmed();
@@ -2370,7 +2665,9 @@ int Gui::findPage(
                                           opts.contStepNumber,
                                           stepNumber,            /*renderStepNumber */
                                           opts.current.modelName /*renderParentModel*/);
-                              findPage(view, scene, meta, line, calloutOpts);
+                              // the submodel is traversed in its own meta scope
+                              MetaScope submodelMetaScope;
+                              findPage(view, scene, submodelMetaScope.inherit(meta), line, calloutOpts);
 
                               saveStepPageNum = stepPageNum;
                               meta.submodelStack.pop_back();
@@ -2443,8 +2740,7 @@ int Gui::findPage(
               if (stepGroup && ! noStep2 && ! buildModIgnore) {
                   stepGroup = false;
                   if (opts.pageNum < displayPageNum) {
-                      saveLineTypeIndexes    = lineTypeIndexes;
-                      saveCsiParts           = csiParts;
+                      partsCopies.copy(saveCsiParts, saveLineTypeIndexes, csiParts, lineTypeIndexes);
                       saveStepNumber         = stepNumber;
                       saveMeta               = meta;
                       saveBfx                = bfx;
@@ -2453,6 +2749,7 @@ int Gui::findPage(
                       saveRotStep            = meta.rotStep;
                       bfxParts.clear();
                     } else if (opts.pageNum == displayPageNum) {
+                      partsCopies.take();
                       lineTypeIndexes.clear();
                       csiParts.clear();
                       savePrevStepPosition = saveCsiParts.size();
@@ -2519,6 +2816,7 @@ int Gui::findPage(
                   ++opts.pageNum;
                   topOfPages.append(opts.current);
                   saveStepPageNum = ++stepPageNum;
+                  topOfNextPage = true;
                 }
               noStep2 = false;
               break;
@@ -2543,9 +2841,8 @@ int Gui::findPage(
                   stepPageNum += ! coverPage && ! stepGroup;
                   if (opts.pageNum < displayPageNum) {
                       if ( ! stepGroup) {
-                          saveLineTypeIndexes    = lineTypeIndexes;
+                          partsCopies.copy(saveCsiParts, saveLineTypeIndexes, csiParts, lineTypeIndexes);
                           saveStepNumber         = stepNumber;
-                          saveCsiParts           = csiParts;
                           saveMeta               = meta;
                           saveBfx                = bfx;
                           saveBfxParts           = bfxParts;
@@ -2561,6 +2858,7 @@ int Gui::findPage(
                     }
                   if ( ! stepGroup) {
                       if (opts.pageNum == displayPageNum) {
+                          partsCopies.take();
                           lineTypeIndexes.clear();
                           csiParts.clear();
                           savePrevStepPosition = saveCsiParts.size();
@@ -2630,6 +2928,7 @@ int Gui::findPage(
 
                       ++opts.pageNum;
                       topOfPages.append(opts.current);
+                      topOfNextPage = true;
                     }
                   topOfStep = opts.current;
                   partsAdded = 0;
@@ -2681,6 +2980,7 @@ int Gui::findPage(
 
             case ClearRc:
               if (opts.pageNum < displayPageNum) {
+                  partsCopies.take();
                   csiParts.clear();
                   saveCsiParts.clear();
                   lineTypeIndexes.clear();
@@ -2700,6 +3000,7 @@ int Gui::findPage(
 
             case BufferLoadRc:
               if (opts.pageNum < displayPageNum) {
+                  partsCopies.take();
                   csiParts = bfx[meta.bfx.value()];
                   lineTypeIndexes = bfxLineTypeIndexes[meta.bfx.value()];
                 }
@@ -2708,7 +3009,7 @@ int Gui::findPage(
 
             case BuildModBeginRc:
               buildModKey   = meta.LPub.buildMod.value();
-              opts.buildMod = getLevel(buildModKey,HiarchLevel::BEGIN);
+              opts.buildMod = ldrawFile.buildModLevel(opts.current,BuildModBlock::EndClose);
               buildModAction = getBuildModAction(buildModKey, stepNumber);
               if (buildModAction == BuildModApplyRc){
                   buildModIgnore = false;
@@ -2718,7 +3019,7 @@ int Gui::findPage(
               break;
 
             case BuildModEndRc:
-              opts.buildMod  = getLevel(QString(),HiarchLevel::END);
+              opts.buildMod  = ldrawFile.buildModLevel(opts.current,BuildModBlock::EndClose);
               buildModIgnore = false;
               break;
 
@@ -2779,6 +3080,7 @@ int Gui::findPage(
                     } else {
                         remove_partname(csiParts,lineTypeIndexes,meta.LPub.remove.partname.value(),newCSIParts,newLineTypeIndexes);
                     }
+                    partsCopies.take();
                     csiParts = newCSIParts;
                     lineTypeIndexes = newLineTypeIndexes;
                   }
@@ -2858,10 +3160,20 @@ int Gui::findPage(
             default:
               break;
             } // switch
+
+          if (topOfNextPage) {
+              topOfNextPage = false;
+              savePageCheckpoint();
+          }
           break;
         }
     } // for every line
 
+  if (endOfPages) {
+      return HitEndOfPage;
+  }
+
+  partsCopies.take();
   csiParts.clear();
   lineTypeIndexes.clear();
 
@@ -2961,7 +3273,7 @@ int Gui::getBOMParts(
 
   QHash<QString, QStringList> bfx;
 
-  int numLines = ldrawFile.size(current.modelName);
+  int numLines = ldrawFile.size(current);
 
   Rc rc;
 
@@ -2972,7 +3284,7 @@ int Gui::getBOMParts(
       // scan through the rest of the model counting pages
       // if we've already hit the display page, then do as little as possible
 
-      QString line = ldrawFile.readLine(current.modelName,current.lineNumber).trimmed();
+      QString line = ldrawFile.readLine(current).trimmed();
 
       if (line.startsWith("0 GHOST ")) {
           line = line.mid(8).trimmed();
@@ -3147,12 +3459,12 @@ int Gui::getBOMParts(
 
             case BuildModBeginRc:
               buildModKey    = meta.LPub.buildMod.value();
-              buildMod       = getLevel(buildModKey,HiarchLevel::BEGIN);
+              buildMod       = ldrawFile.buildModLevel(current,BuildModBlock::EndModClose);
               buildModIgnore = true;
               break;
 
             case BuildModEndModRc:
-              buildMod = getLevel(QString(),HiarchLevel::END);
+              buildMod = ldrawFile.buildModLevel(current,BuildModBlock::EndModClose);
               if (!buildMod)
                   buildModIgnore = false;
               break;
@@ -3215,7 +3527,7 @@ int Gui::getBOMOccurrence(Where	current) {		// start at top of ldrawFile
 
   skipHeader(current);
 
-  int numLines        = ldrawFile.size(current.modelName);
+  int numLines        = ldrawFile.size(current);
   int occurrenceNum   = 0;
   boms                = 0;
   bomOccurrence       = 0;
@@ -3224,7 +3536,7 @@ int Gui::getBOMOccurrence(Where	current) {		// start at top of ldrawFile
   for ( ; current.lineNumber < numLines;
         current.lineNumber++) {
 
-      QString line = ldrawFile.readLine(current.modelName,current.lineNumber).trimmed();
+      QString line = ldrawFile.readLine(current).trimmed();
       switch (line.toLatin1()[0]) {
         case '1':
           {
@@ -3264,7 +3576,7 @@ int Gui::getBOMOccurrence(Where	current) {		// start at top of ldrawFile
   if (occurrenceNum > 1) {
       // now set the bom occurrance based on our current position
       Where here = gui->topOfPages[gui->displayPageNum-1];
-      for (++here; here.lineNumber < ldrawFile.size(here.modelName); here++) {
+      for (++here; here.lineNumber < ldrawFile.size(here); here++) {
           QString line = gui->readLine(here);
           Meta meta;
           Rc rc;
@@ -3340,7 +3652,7 @@ void Gui::attitudeAdjustment()
            current.lineNumber < numLines;
            current.lineNumber++) {
 
-          QString line = ldrawFile.readLine(current.modelName,current.lineNumber);
+          QString line = ldrawFile.readLine(current);
           QStringList argv;
           split(line,argv);
 
@@ -3392,7 +3704,6 @@ void Gui::countPages()
       QString empty;
       PgSizeData emptyPageSize;
       stepPageNum = 1;
-      LDrawFile::_currentLevels.clear();
       FindPageOptions findOptions(
                   maxPages,
                   current,
@@ -3441,7 +3752,25 @@ void Gui::drawPage(
   saveContStepNum = 1;
   currentStep = nullptr;
   Preferences::enableLineTypeIndexes = true;
-  LDrawFile::_currentLevels.clear();
+
+  // resume from the nearest page checkpoint at or before the display page
+  PageCheckpoint *checkpoint = nullptr;
+  QMap<int, PageCheckpoint*>::const_iterator cp = pageCheckpoints.constFind(displayPageNum);
+  if (cp == pageCheckpoints.constEnd()) {
+      cp = pageCheckpoints.upperBound(displayPageNum);
+      if (cp != pageCheckpoints.constBegin())
+          --cp;
+      else
+          cp = pageCheckpoints.constEnd();
+  }
+  QList<Where> savedTopOfPages;
+  if (cp != pageCheckpoints.constEnd() && cp.key() <= topOfPages.size()) {
+      checkpoint = cp.value();
+      maxPages   = cp.key();
+      savedTopOfPages = topOfPages;
+      while (topOfPages.size() > maxPages)
+          topOfPages.removeLast();
+  }
 
   PgSizeData pageSize;
   if (exporting()) {
@@ -3467,10 +3796,22 @@ void Gui::drawPage(
               0     /*buildMod*/,
               0     /*contStepNumber*/,
               0     /*renderStepNumber*/,
-              empty /*renderParentModel*/);
-  findPage(view,scene,meta,empty/*addLine*/,findOptions);
-  topOfPages.append(current);
-  maxPages--;
+              empty /*renderParentModel*/,
+              checkpoint);
+  recordPageCheckpoints = true;
+  int rc = findPage(view,scene,meta,empty/*addLine*/,findOptions);
+  recordPageCheckpoints = false;
+  if (rc == HitEndOfPage) {
+      // the remaining page positions are unchanged since the last complete traversal
+      for (int i = topOfPages.size(); i < savedTopOfPages.size(); i++)
+          topOfPages.append(savedTopOfPages[i]);
+      maxPages = pageCheckpointsMaxPages;
+  } else {
+      topOfPages.append(current);
+      maxPages--;
+      pageCheckpointsMaxPages = maxPages;
+      pageCheckpointsComplete = true;
+  }
 
   QString string = QString("%1 of %2") .arg(displayPageNum) .arg(maxPages);
   if (! exporting())
@@ -3481,7 +3822,7 @@ void Gui::drawPage(
 
 void Gui::skipHeader(Where &current)
 {
-  int numLines = ldrawFile.size(current.modelName);
+  int numLines = ldrawFile.size(current);
   for ( ; current.lineNumber < numLines; current.lineNumber++) {
       QString line = gui->readLine(current);
       int p;
@@ -3548,6 +3889,45 @@ void Gui::include(Meta &meta)
     }
 }
 
+/*
+ * Page checkpoints are owned by the Gui and released when the model is
+ * closed. An edit only releases the checkpoints whose captured state
+ * includes the edited line: top level model edits at or before the
+ * checkpoint line, and submodel edits once the submodel was entered.
+ */
+
+void Gui::clearPageCheckpoints()
+{
+  qDeleteAll(pageCheckpoints);
+  pageCheckpoints.clear();
+  pageCheckpointsComplete = false;
+  pageCheckpointsMaxPages = 0;
+}
+
+void Gui::clearPageCheckpoints(const QString &modelName, int lineNumber)
+{
+  pageCheckpointsComplete = false;
+
+  if (pageCheckpoints.isEmpty())
+      return;
+
+  QString fileName = modelName.toLower();
+  bool topLevel = fileName == ldrawFile.topLevelFile().toLower();
+
+  QMap<int, PageCheckpoint*>::iterator i = pageCheckpoints.begin();
+  while (i != pageCheckpoints.end()) {
+      PageCheckpoint *cp = i.value();
+      bool invalid = topLevel ? cp->current.lineNumber >= lineNumber :
+                                cp->renderedState.contains(fileName);
+      if (invalid) {
+          delete cp;
+          i = pageCheckpoints.erase(i);
+      } else {
+          ++i;
+      }
+  }
+}
+
 static Where dummy;
 
 Where &Gui::topOfPage()
@@ -3570,218 +3950,339 @@ Where &Gui::bottomOfPage()
 }
 
 /*
- * This function applies buffer exchange and LPub's remove
- * meta commands before writing them out for the renderers to use.
- * Fade, Highlight and COLOUR meta commands are preserved.
- * This eliminates the need for ghosting parts removed by buffer
- * exchange
+ * A file written to the temp directory. Its content is serialized and
+ * hashed before writing; the file is left alone when the hash matches the
+ * one recorded in the temp directory manifest and the file still exists.
  */
 
-void Gui::writeToTmp(const QString &fileName,
-                     const QStringList &contents)
+struct TmpFile
 {
-  QString fname = QDir::toNativeSeparators(QDir::currentPath()) + QDir::separator() + Paths::tmpDir + QDir::separator() + fileName;
+  QString     fileName;
+  QStringList contents;
+  PartType    partType;       // NORMAL_PART or the fade/highlight copy to configure
+  QByteArray  hash;           // recorded hash in, content hash out
+  QString     error;
+  bool        written;
+
+  TmpFile()
+    : partType(NORMAL_PART),
+      written(false)
+  {}
+  TmpFile(const QString     &_fileName,
+          const QStringList &_contents,
+          PartType           _partType,
+          const QByteArray  &_hash)
+    : fileName(_fileName),
+      contents(_contents),
+      partType(_partType),
+      hash(_hash),
+      written(false)
+  {}
+};
+
+#define TMP_MANIFEST_FILE    "tmpfiles.manifest"
+#define TMP_MANIFEST_MAGIC   0x4C50544D // LPTM
+#define TMP_MANIFEST_VERSION 1
+
+static QString tmpFilePath(const QString &fileName)
+{
+  return QDir::toNativeSeparators(QDir::currentPath()) + QDir::separator() + Paths::tmpDir + QDir::separator() + fileName;
+}
+
+/*
+ * Safe to run in a worker thread, it touches nothing but tmpFile.
+ */
+
+static void writeTmpFile(TmpFile &tmpFile)
+{
+  QByteArray buffer;
+  QTextStream out(&buffer, QIODevice::WriteOnly);
+  for (int i = 0; i < tmpFile.contents.size(); i++) {
+      out << tmpFile.contents[i] << "\n";
+    }
+  out.flush();
+
+  QByteArray hash = QCryptographicHash::hash(buffer, QCryptographicHash::Sha1);
+  QString fname = tmpFilePath(tmpFile.fileName);
+  if (hash == tmpFile.hash && QFileInfo::exists(fname))
+      return;
+
   QFileInfo fileInfo(fname);
   if(!fileInfo.dir().exists()) {
      fileInfo.dir().mkpath(".");
     }
   QFile file(fname);
   if ( ! file.open(QFile::WriteOnly|QFile::Text)) {
+      tmpFile.error = file.errorString();
+    } else if (file.write(buffer) != buffer.size()) {
+      tmpFile.error = file.errorString();
+    } else {
+      tmpFile.hash    = hash;
+      tmpFile.written = true;
+    }
+}
+
+void Gui::readTmpManifest()
+{
+  QString manifest = tmpFilePath(TMP_MANIFEST_FILE);
+  if (manifest == tmpManifest)
+      return;
+
+  tmpManifest = manifest;
+  tmpFileHashes.clear();
+
+  QFile file(manifest);
+  if (! file.open(QFile::ReadOnly))
+      return;
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic, version;
+  in >> magic >> version;
+  if (magic != TMP_MANIFEST_MAGIC || version != TMP_MANIFEST_VERSION)
+      return;
+
+  in >> tmpFileHashes;
+  if (in.status() != QDataStream::Ok)
+      tmpFileHashes.clear();
+}
+
+void Gui::writeTmpManifest()
+{
+  QFile file(tmpFilePath(TMP_MANIFEST_FILE));
+  if (! file.open(QFile::WriteOnly)) {
+      emit messageSig(LOG_ERROR, QString("Cannot write temp directory manifest %1: %2")
+                                         .arg(file.fileName()).arg(file.errorString()));
+      return;
+    }
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << quint32(TMP_MANIFEST_MAGIC) << quint32(TMP_MANIFEST_VERSION) << tmpFileHashes;
+}
+
+void Gui::writeToTmp(const QString &fileName,
+                     const QStringList &contents)
+{
+  readTmpManifest();
+
+  TmpFile tmpFile(fileName, tmpFileContents(fileName, contents), NORMAL_PART, tmpFileHashes.value(fileName));
+  writeTmpFile(tmpFile);
+  if (! tmpFile.error.isEmpty()) {
       QMessageBox::warning(nullptr,QMessageBox::tr("LPub3D"),
                            QMessageBox::tr("Failed to open %1 for writing: %2")
-                           .arg(fname) .arg(file.errorString()));
-    } else {
+                           .arg(tmpFilePath(fileName)) .arg(tmpFile.error));
+    } else if (tmpFile.written) {
+      tmpFileHashes.insert(fileName, tmpFile.hash);
+      writeTmpManifest();
+    }
+}
 
-      /*
-       * For writeToTemp(), the buildMod behaviour captures the appropriate 'block' of lines
-       * to write submodels to the temp working directory.
-       *
-       * The buildMod flag is enabled for the lines between BUILD_MOD BEGIN and BUILD_MOD END
-       * Lines between BUILD_MOD BEGIN and BUILD_MOD END_MOD represent the modified content
-       * Lines between BUILD_MOD END_MOD and BUILD_MOD END represent the original content
-       *
-       * When the buildMod flag is true:
-       * Parse is enabled when 'buildModIgnore' is false.
-       * When the build mod action is 'apply', the modification block is parsed. (buildModIgnore is false)
-       * When the build mod action is 'remove', the default block is parsed. (buildModIgnore is false)
-       * When the build mod is at 'end' 'buildModIgnore' is false and
-       * buildMod is reset to false if the build mod command is not nested
-       * Remove group, partType and partName is applied when 'buildModIgnore' is false.
-       *
-       * When the build mod meta command is BUILD_MOD END 'buildModIgnore' and 'buildModPliIgnore'
-       * are reset to false while buildMod is reset to false if the build mod command is not nested
-       *
-       * BUILD_MOD APPLY or BUILD_MOD REMOVE action meta commands are ignored
-       *
-       * When the buildMod flag is false, lines are processed normally.
-       */
+/*
+ * This function applies buffer exchange and LPub's remove
+ * meta commands before writing them out for the renderers to use.
+ * Fade, Highlight and COLOUR meta commands are preserved.
+ * This eliminates the need for ghosting parts removed by buffer
+ * exchange
+ */
 
-      int buildMod         = 0;
-      int modBeginLineNum  = 0;
-      int modActionLineNum = 0;
-      int modEndLineNum    = 0;
-      int buildModAction   = BuildModApplyRc;
-      int stepNumber       = currentStep ? currentStep->stepNumber.number : 0;
-      bool buildModIgnore  = false;
-      bool buildModItems   = false;
-
-      QString buildModKey;
-
-      QVector<int> lineTypeIndexes, buildModLineTypeIndexes;
-      QStringList  csiParts, buildModCsiParts;
-      QHash<QString, QStringList> bfx;
-      int fileNameIndex = ldrawFile.getSubmodelIndex(fileName);
-
-      PartLineAttributes pla(
-         csiParts,
-         lineTypeIndexes,
-         buildModCsiParts,
-         buildModLineTypeIndexes,
-         buildMod,
-         buildModIgnore,
-         buildModItems);
-
-      auto updateBuildModAttributes =
-             [this,
-              &modBeginLineNum,
-              &modActionLineNum,
-              &modEndLineNum,
-              &buildModKey,
-              &stepNumber,
-              &fileNameIndex] (Rc rc)
-      {
-          // Adjust position for meta command line
-          int _modBeginLineNum  = modBeginLineNum  + 1;
-          int _modActionLineNum = modActionLineNum + 1;
-          int _modEndLineNum    = modEndLineNum    + 1;
-
-          QVector<int> modAttributes = { _modBeginLineNum,
-                                         _modActionLineNum,
-                                         _modEndLineNum,
-                                         fileNameIndex };
-
-          insertBuildMod(buildModKey,
-                         modAttributes,
-                         rc /*Action*/,
-                         stepNumber);
-      };
-
-      for (int i = 0; i < contents.size(); i++) {
-          QString line = contents[i];
-          QStringList tokens;
+QStringList Gui::tmpFileContents(const QString &fileName,
+                                 const QStringList &contents)
+{
+  /*
+   * For writeToTemp(), the buildMod behaviour captures the appropriate 'block' of lines
+   * to write submodels to the temp working directory.
+   *
+   * The buildMod flag is enabled for the lines between BUILD_MOD BEGIN and BUILD_MOD END
+   * Lines between BUILD_MOD BEGIN and BUILD_MOD END_MOD represent the modified content
+   * Lines between BUILD_MOD END_MOD and BUILD_MOD END represent the original content
+   *
+   * When the buildMod flag is true:
+   * Parse is enabled when 'buildModIgnore' is false.
+   * When the build mod action is 'apply', the modification block is parsed. (buildModIgnore is false)
+   * When the build mod action is 'remove', the default block is parsed. (buildModIgnore is false)
+   * When the build mod is at 'end' 'buildModIgnore' is false and
+   * buildMod is reset to false if the build mod command is not nested
+   * Remove group, partType and partName is applied when 'buildModIgnore' is false.
+   *
+   * When the build mod meta command is BUILD_MOD END 'buildModIgnore' and 'buildModPliIgnore'
+   * are reset to false while buildMod is reset to false if the build mod command is not nested
+   *
+   * BUILD_MOD APPLY or BUILD_MOD REMOVE action meta commands are ignored
+   *
+   * When the buildMod flag is false, lines are processed normally.
+   */
 
-          split(line,tokens);
-          if (tokens.size()) {
-              if (tokens[0] != "0") {
-                  CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,OkRc);
-              } else {
-                  Meta  meta;
-                  Rc    rc;
-                  Where here(fileName,i);
-                  rc = meta.parse(line,here,false);
-
-                  switch (rc) {
-                  case FadeRc:
-                  case SilhouetteRc:
-                  case ColourRc:
-                      CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,rc);
-                      break;
+  int buildMod         = 0;
+  int modBeginLineNum  = 0;
+  int modActionLineNum = 0;
+  int modEndLineNum    = 0;
+  int buildModAction   = BuildModApplyRc;
+  int stepNumber       = currentStep ? currentStep->stepNumber.number : 0;
+  bool buildModIgnore  = false;
+  bool buildModItems   = false;
 
-                      /* Buffer exchange */
-                  case BufferStoreRc:
-                      bfx[meta.bfx.value()] = csiParts;
-                      break;
+  QString buildModKey;
 
-                  case BufferLoadRc:
-                      csiParts = bfx[meta.bfx.value()];
-                      break;
+  QVector<int> lineTypeIndexes, buildModLineTypeIndexes;
+  QStringList  csiParts, buildModCsiParts;
+  QHash<QString, QStringList> bfx;
+  int fileNameIndex = ldrawFile.getSubmodelIndex(fileName);
 
-                  case BuildModBeginRc:
-                      buildModKey     = meta.LPub.buildMod.value();
-                      buildMod        = getLevel(buildModKey,HiarchLevel::BEGIN);
-                      modBeginLineNum = here.lineNumber;
-                      buildModAction  = getBuildModAction(buildModKey, stepNumber);
-                      if (buildModAction == BuildModApplyRc){
-                          buildModIgnore = false;
-                      } else if (buildModAction == BuildModRemoveRc){
-                          buildModIgnore = true;
-                      }
-                      break;
+  PartLineAttributes pla(
+     csiParts,
+     lineTypeIndexes,
+     buildModCsiParts,
+     buildModLineTypeIndexes,
+     buildMod,
+     buildModIgnore,
+     buildModItems);
 
-                  case BuildModEndModRc:
-                      if (buildMod > 1) {
-                        if (meta.LPub.buildMod.value().isEmpty())
-                          parseError("Key required for nested build mod meta command",
-                                     here,Preferences::ParseErrors);
-                        else
-                          buildModKey = meta.LPub.buildMod.value();
-                      }
-                      modActionLineNum = here.lineNumber;
-                      updateBuildModAttributes(rc);
-                      buildModAction = getBuildModAction(buildModKey, stepNumber);
-                      if (buildModAction == BuildModApplyRc){
-                          buildModIgnore = true;
-                      } else if (buildModAction == BuildModRemoveRc){
-                          buildModIgnore = false;
-                      }
-                    break;
+  auto updateBuildModAttributes =
+         [this,
+          &modBeginLineNum,
+          &modActionLineNum,
+          &modEndLineNum,
+          &buildModKey,
+          &stepNumber,
+          &fileNameIndex] (Rc rc)
+  {
+      // Adjust position for meta command line
+      int _modBeginLineNum  = modBeginLineNum  + 1;
+      int _modActionLineNum = modActionLineNum + 1;
+      int _modEndLineNum    = modEndLineNum    + 1;
+
+      QVector<int> modAttributes = { _modBeginLineNum,
+                                     _modActionLineNum,
+                                     _modEndLineNum,
+                                     fileNameIndex };
+
+      insertBuildMod(buildModKey,
+                     modAttributes,
+                     rc /*Action*/,
+                     stepNumber);
+  };
+
+  for (int i = 0; i < contents.size(); i++) {
+      QString line = contents[i];
+      QStringList tokens;
+
+      split(line,tokens);
+      if (tokens.size()) {
+          if (tokens[0] != "0") {
+              CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,OkRc);
+          } else {
+              Meta  meta;
+              Rc    rc;
+              Where here(fileName,i);
+              rc = meta.parse(line,here,false);
+
+              switch (rc) {
+              case FadeRc:
+              case SilhouetteRc:
+              case ColourRc:
+                  CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,rc);
+                  break;
+
+                  /* Buffer exchange */
+              case BufferStoreRc:
+                  bfx[meta.bfx.value()] = csiParts;
+                  break;
+
+              case BufferLoadRc:
+                  csiParts = bfx[meta.bfx.value()];
+                  break;
 
-                  case BuildModEndRc:
-                      buildMod       = getLevel(QString(),HiarchLevel::END);
-                      modEndLineNum  = here.lineNumber;
+              case BuildModBeginRc:
+                  buildModKey     = meta.LPub.buildMod.value();
+                  buildMod        = ldrawFile.buildModLevel(here,BuildModBlock::EndClose);
+                  modBeginLineNum = here.lineNumber;
+                  buildModAction  = getBuildModAction(buildModKey, stepNumber);
+                  if (buildModAction == BuildModApplyRc){
                       buildModIgnore = false;
-                    break;
-
-                  case PartNameRc:
-                  case PartTypeRc:
-                  case MLCadGroupRc:
-                  case LDCadGroupRc:
-                  case LeoCadModelRc:
-                  case LeoCadPieceRc:
-                  case LeoCadCameraRc:
-                  case LeoCadLightRc:
-                  case LeoCadSynthRc:
-                  case LeoCadGroupBeginRc:
-                  case LeoCadGroupEndRc:
-                      CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,rc);
-                      break;
+                  } else if (buildModAction == BuildModRemoveRc){
+                      buildModIgnore = true;
+                  }
+                  break;
 
-                      /* remove a group or all instances of a part type */
-                  case RemoveGroupRc:
-                  case RemovePartTypeRc:
-                  case RemovePartNameRc:
-                      if (! buildModIgnore) {
-                          QStringList newCSIParts;
-                          QVector<int> newLineTypeIndexes;
-                          if (rc == RemoveGroupRc) {
-                              remove_group(csiParts,lineTypeIndexes,meta.LPub.remove.group.value(),newCSIParts,newLineTypeIndexes,meta);
-                          } else if (rc == RemovePartTypeRc) {
-                              remove_parttype(csiParts,lineTypeIndexes,meta.LPub.remove.parttype.value(),newCSIParts,newLineTypeIndexes);
-                          } else {
-                              remove_partname(csiParts,lineTypeIndexes,meta.LPub.remove.partname.value(),newCSIParts,newLineTypeIndexes);
-                          }
-                          csiParts = newCSIParts;
-                          lineTypeIndexes = newLineTypeIndexes;
-                      }
-                      break;
+              case BuildModEndModRc:
+                  if (buildMod > 1) {
+                    if (meta.LPub.buildMod.value().isEmpty())
+                      parseError("Key required for nested build mod meta command",
+                                 here,Preferences::ParseErrors);
+                    else
+                      buildModKey = meta.LPub.buildMod.value();
+                  }
+                  modActionLineNum = here.lineNumber;
+                  updateBuildModAttributes(rc);
+                  buildModAction = getBuildModAction(buildModKey, stepNumber);
+                  if (buildModAction == BuildModApplyRc){
+                      buildModIgnore = true;
+                  } else if (buildModAction == BuildModRemoveRc){
+                      buildModIgnore = false;
+                  }
+                break;
 
-                  default:
-                      break;
+              case BuildModEndRc:
+                  buildMod       = ldrawFile.buildModLevel(here,BuildModBlock::EndClose);
+                  modEndLineNum  = here.lineNumber;
+                  buildModIgnore = false;
+                break;
+
+              case PartNameRc:
+              case PartTypeRc:
+              case MLCadGroupRc:
+              case LDCadGroupRc:
+              case LeoCadModelRc:
+              case LeoCadPieceRc:
+              case LeoCadCameraRc:
+              case LeoCadLightRc:
+              case LeoCadSynthRc:
+              case LeoCadGroupBeginRc:
+              case LeoCadGroupEndRc:
+                  CsiItem::partLine(line,pla,i/*relativeTypeIndx*/,rc);
+                  break;
+
+                  /* remove a group or all instances of a part type */
+              case RemoveGroupRc:
+              case RemovePartTypeRc:
+              case RemovePartNameRc:
+                  if (! buildModIgnore) {
+                      QStringList newCSIParts;
+                      QVector<int> newLineTypeIndexes;
+                      if (rc == RemoveGroupRc) {
+                          remove_group(csiParts,lineTypeIndexes,meta.LPub.remove.group.value(),newCSIParts,newLineTypeIndexes,meta);
+                      } else if (rc == RemovePartTypeRc) {
+                          remove_parttype(csiParts,lineTypeIndexes,meta.LPub.remove.parttype.value(),newCSIParts,newLineTypeIndexes);
+                      } else {
+                          remove_partname(csiParts,lineTypeIndexes,meta.LPub.remove.partname.value(),newCSIParts,newLineTypeIndexes);
+                      }
+                      csiParts = newCSIParts;
+                      lineTypeIndexes = newLineTypeIndexes;
                   }
+                  break;
+
+              default:
+                  break;
               }
           }
       }
+  }
 
-      ldrawFile.setLineTypeRelativeIndexes(fileNameIndex,lineTypeIndexes);
+  ldrawFile.setLineTypeRelativeIndexes(fileNameIndex,lineTypeIndexes);
 
-      QTextStream out(&file);
-      for (int i = 0; i < csiParts.size(); i++) {
-          out << csiParts[i] << endl;
-        }
-      file.close();
-    }
+  return csiParts;
 }
 
+/*
+ * Changed submodels are rendered to their temp file content in order, the
+ * content of a build modification depends on the ones before it. Fade and
+ * highlight copies are only made for subfiles a submodel of the model
+ * uses - the top level model and unused submodels are never faded.
+ * Serializing, configuring and writing then run on the thread pool.
+ */
+
 void Gui::writeToTmp()
 {
   if (Preferences::modeGUI && ! exporting()) {
@@ -3797,7 +4298,32 @@ void Gui::writeToTmp()
 
   QString fadeColor = LDrawColor::ldColorCode(page.meta.LPub.fadeStep.fadeColor.value());
 
-  QStringList content, configuredContent;
+  readTmpManifest();
+
+  QSet<QString> referenced, submodels;
+  if (doFadeStep || doHighlightStep) {
+      ldrawFile.countInstances();
+      referenced = ldrawFile.referencedSubFiles();
+      for (int i = 0; i < ldrawFile._subFileOrder.size(); i++) {
+          if (ldrawFile.isSubmodel(ldrawFile._subFileOrder[i]))
+              submodels.insert(ldrawFile._subFileOrder[i].toLower());
+        }
+    }
+
+  // capture file name extensions
+  auto configuredFileName = [] (const QString &fileName, const QString &nameMod)
+  {
+      QString fileNameStr = fileName;
+      QString extension = QFileInfo(fileName).suffix().toLower();
+      if (extension.isEmpty()) {
+        fileNameStr = fileNameStr.append(QString("%1.ldr").arg(nameMod));
+      } else {
+        fileNameStr = fileNameStr.replace("."+extension, QString("%1.%2").arg(nameMod).arg(extension));
+      }
+      return fileNameStr;
+  };
+
+  QList<TmpFile> tmpFiles;
 
   for (int i = 0; i < ldrawFile._subFileOrder.size(); i++) {
 
@@ -3806,52 +4332,64 @@ void Gui::writeToTmp()
       normalizeHeader(here);
 
       QString fileName = ldrawFile._subFileOrder[i].toLower();
+      QString fadeFileName = configuredFileName(fileName, FADE_SFX);
+      QString highlightFileName = configuredFileName(fileName, HIGHLIGHT_SFX);
 
       if (Preferences::modeGUI && ! exporting())
         emit progressPermSetValueSig(i);
 
-      content = ldrawFile.contents(fileName);
-
+      // write normal submodels...
       if (ldrawFile.changedSinceLastWrite(fileName)) {
-          // write normal submodels...
-          upToDate = false;
-          emit messageSig(LOG_INFO, "Writing submodel to temp directory: " + fileName + "...");
-          writeToTmp(fileName,content);
-
-          // capture file name extensions
-          QString fileNameStr;
-          QString extension = QFileInfo(fileName).suffix().toLower();
-
-          // write configured (Fade) submodels
-          if (doFadeStep) {
-             fileNameStr = fileName;
-             if (extension.isEmpty()) {
-               fileNameStr = fileNameStr.append(QString("%1.ldr").arg(FADE_SFX));
-             } else {
-               fileNameStr = fileNameStr.replace("."+extension, QString("%1.%2").arg(FADE_SFX).arg(extension));
-             }
+          tmpFiles << TmpFile(fileName,
+                              tmpFileContents(fileName, ldrawFile.contents(fileName)),
+                              NORMAL_PART,
+                              tmpFileHashes.value(fileName));
+          staleTmpVariants << fadeFileName << highlightFileName;
+      }
 
-            /* Faded version of submodels */
-            emit messageSig(LOG_INFO, "Writing fade submodels to temp directory: " + fileNameStr);
-            configuredContent = configureModelSubFile(content, fadeColor, FADE_PART);
-            writeToTmp(fileNameStr,configuredContent);
-          }
-          // write configured (Highlight) submodels
-          if (doHighlightStep) {
-            fileNameStr = fileName;
-            if (extension.isEmpty()) {
-              fileNameStr = fileNameStr.append(QString("%1.ldr").arg(HIGHLIGHT_SFX));
-            } else {
-              fileNameStr = fileNameStr.replace("."+extension, QString("%1.%2").arg(HIGHLIGHT_SFX).arg(extension));
-            }
-            /* Highlighted version of submodels */
-            emit messageSig(LOG_INFO, "Writing highlight submodel to temp directory: " + fileNameStr);
-            configuredContent = configureModelSubFile(content, fadeColor, HIGHLIGHT_PART);
-            writeToTmp(fileNameStr,configuredContent);
-          }
+      // write configured (Fade and Highlight) submodels that are used
+      bool configured = referenced.contains(fileName) || ! submodels.contains(fileName);
+      if (doFadeStep && configured && staleTmpVariants.remove(fadeFileName)) {
+          tmpFiles << TmpFile(fadeFileName,
+                              ldrawFile.contents(fileName),
+                              FADE_PART,
+                              tmpFileHashes.value(fadeFileName));
+      }
+      if (doHighlightStep && configured && staleTmpVariants.remove(highlightFileName)) {
+          tmpFiles << TmpFile(highlightFileName,
+                              ldrawFile.contents(fileName),
+                              HIGHLIGHT_PART,
+                              tmpFileHashes.value(highlightFileName));
       }
   }
 
+  QtConcurrent::blockingMap(tmpFiles, [this, &fadeColor, &submodels] (TmpFile &tmpFile)
+  {
+      if (tmpFile.partType != NORMAL_PART)
+          tmpFile.contents = configureModelSubFile(tmpFile.contents, fadeColor, tmpFile.partType, submodels);
+      writeTmpFile(tmpFile);
+  });
+
+  for (int i = 0; i < tmpFiles.size(); i++) {
+      const TmpFile &tmpFile = tmpFiles[i];
+      if (! tmpFile.error.isEmpty()) {
+          if (tmpFile.partType != NORMAL_PART)
+              staleTmpVariants << tmpFile.fileName;
+          QMessageBox::warning(nullptr,QMessageBox::tr("LPub3D"),
+                               QMessageBox::tr("Failed to open %1 for writing: %2")
+                               .arg(tmpFilePath(tmpFile.fileName)) .arg(tmpFile.error));
+      } else if (tmpFile.written) {
+          upToDate = false;
+          tmpFileHashes.insert(tmpFile.fileName, tmpFile.hash);
+          emit messageSig(LOG_INFO, "Wrote submodel to temp directory: " + tmpFile.fileName);
+      }
+  }
+
+  if (! upToDate)
+      writeTmpManifest();
+
+  ldrawFile.packSubFiles();
+
   bool generateSubModelImages = Preferences::modeGUI &&
                                 gApplication->mPreferences.mViewPieceIcons &&
                                 ! submodelIconsLoaded;
@@ -3880,7 +4418,7 @@ void Gui::writeToTmp()
 /*
  * Configure writeToTmp content - make fade or highlight copies of submodel files.
  */
-QStringList Gui::configureModelSubFile(const QStringList &contents, const QString &fadeColour, const PartType partType)
+QStringList Gui::configureModelSubFile(const QStringList &contents, const QString &fadeColour, const PartType partType, const QSet<QString> &submodels)
 {
   QString nameMod, colourPrefix;
   if (partType == FADE_PART){
@@ -3943,7 +4481,7 @@ QStringList Gui::configureModelSubFile(const QStringList &contents, const QStrin
                   }
                 }
               // subfiles
-              if (ldrawFile.isSubmodel(fileNameStr)) {
+              if (submodels.contains(fileNameStr)) {
                   if (extension.isEmpty()) {
                     fileNameStr = fileNameStr.append(QString("%1.ldr").arg(nameMod));
                   } else {
@@ -39,7 +39,7 @@ void Gui::appendLine(const Where &here, const QString &line, QUndoCommand *paren
 void Gui::replaceLine(const Where &here, const QString &line, QUndoCommand *parent)
 {
   if (ldrawFile.contains(here.modelName) && 
-      here.lineNumber < ldrawFile.size(here.modelName)) {
+      here.lineNumber < ldrawFile.size(here)) {
 
     undoStack->push(new ReplaceLineCommand(&ldrawFile,here,line,parent));
   }
@@ -48,14 +48,14 @@ void Gui::replaceLine(const Where &here, const QString &line, QUndoCommand *pare
 void Gui::deleteLine(const Where &here, QUndoCommand *parent)
 {
   if (ldrawFile.contains(here.modelName) && 
-      here.lineNumber < ldrawFile.size(here.modelName)) {
+      here.lineNumber < ldrawFile.size(here)) {
     undoStack->push(new DeleteLineCommand(&ldrawFile,here,parent));
   }
 }
 
 QString Gui::readLine(const Where &here)
 {
-  return ldrawFile.readLine(here.modelName,here.lineNumber);
+  return ldrawFile.readLine(here);
 }
 
 void Gui::beginMacro(QString name)
@@ -129,7 +129,7 @@ void Gui::normalizeHeader(const Where &here)
 {
   Where current = here;
 
-  int numLines = ldrawFile.size(current.modelName);
+  int numLines = ldrawFile.size(current);
   for ( ; current.lineNumber < numLines; current.lineNumber++) {
       QString line = gui->readLine(current);
       int p;
@@ -69,16 +69,26 @@ class Where
     QString modelName;
     int     lineNumber;
 
+    /* The LDrawFile submodel handle resolved for modelName. It is
+     * only trusted while modelName still shares handleName's data,
+     * assigning a new modelName makes LDrawFile resolve it again.
+     */
+    mutable int     modelHandle;
+    mutable QString handleName;
+
     Where()
     {
       modelName     = "undefined";
       lineNumber    = 0;
+      modelHandle   = -1;
     }
 
     Where(const Where &rhs)
     {
       modelName = rhs.modelName;
       lineNumber  = rhs.lineNumber;
+      modelHandle = rhs.modelHandle;
+      handleName  = rhs.handleName;
     }
 
     Where operator=(const Where &rhs)
@@ -86,6 +96,8 @@ class Where
       if (this != &rhs) {
         modelName = rhs.modelName;
         lineNumber = rhs.lineNumber;
+        modelHandle = rhs.modelHandle;
+        handleName  = rhs.handleName;
       }
       return *this;
     }
@@ -96,11 +108,13 @@ class Where
     {
       modelName     = _modelName;
       lineNumber    = _lineNumber;
+      modelHandle   = -1;
     }
 
     Where(int _lineNumber)
     {
       lineNumber = _lineNumber;
+      modelHandle = -1;
     }
 
     const Where operator+(const int &where) const